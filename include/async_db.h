@@ -0,0 +1,72 @@
+#pragma once
+#include "db.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <atomic>
+
+// Асинхронный доступ к БД. Несколько неблокирующих соединений обслуживает
+// один поток-реактор (epoll на Linux, poll на остальных системах):
+// запросы уходят через PQsendQueryParams, ответы читаются по готовности сокета
+// (PQconsumeInput/PQisBusy), так что немного потоков держат много запросов в полёте.
+// Методы возвращают std::future; ошибка БД приходит как std::runtime_error в get().
+class AsyncDatabase {
+public:
+    AsyncDatabase(const std::string& conninfo, size_t connections = 4);
+    ~AsyncDatabase();
+
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    std::future<std::vector<Integrator>> get_integrators();
+    std::future<std::vector<City>> get_cities();
+    std::future<int> add_city(const std::string& name);
+    std::future<int> get_city_id(const std::string& name);
+    std::future<void> add_integrator(const std::string& name,
+                                     int city_id,
+                                     const std::string& activity);
+
+    // Запросов в очереди и на соединениях
+    size_t in_flight() const { return pending; }
+
+private:
+    // Запрос к БД: ключ queries.sql, параметры и обработчик итогового результата.
+    // done получает PGresult последней команды (владеет им) или NULL при обрыве соединения.
+    struct Op {
+        Query key;
+        std::vector<std::string> params;
+        int result_format;
+        std::function<void(PGresult*, const std::string& error)> done;
+    };
+
+    struct Conn {
+        PGconn* conn = nullptr;
+        int fd = -1;
+        std::unique_ptr<Op> op;     // выполняющийся запрос, nullptr — соединение свободно
+        PGresult* last = nullptr;   // последний результат текущего запроса
+        bool want_write = false;
+    };
+
+    class Poller;
+
+    void submit(std::unique_ptr<Op> op);
+    void run();
+    void start(Conn& c, std::unique_ptr<Op> op);
+    void on_readable(Conn& c);
+    void on_writable(Conn& c);
+    void finish(Conn& c, const std::string& error);
+    void reconnect(Conn& c);
+    void dispatch();
+
+    std::vector<Conn> conns;
+    std::unique_ptr<Poller> poller;
+    int wake_fd[2] = {-1, -1};   // pipe для пробуждения реактора
+
+    std::mutex m;
+    std::deque<std::unique_ptr<Op>> queue;
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> stopping{false};  // меняется под m, реактор читает без блокировки
+    std::thread reactor;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <functional>
+
+// Кэш "название города -> id" перед add_city.
+// Приложение города не удаляет, поэтому записи не устаревают и не вытесняются.
+// Шарды со своим shared_mutex: поиск разных городов идёт параллельно.
+class CityCache {
+public:
+    // -1, если города нет в кэше
+    int find(const std::string& name) const {
+        const Shard& s = shard(name);
+        std::shared_lock<std::shared_mutex> lk(s.m);
+        auto it = s.ids.find(name);
+        return it == s.ids.end() ? -1 : it->second;
+    }
+
+    void put(const std::string& name, int id) {
+        Shard& s = shard(name);
+        std::unique_lock<std::shared_mutex> lk(s.m);
+        s.ids[name] = id;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto& s : shards) {
+            std::shared_lock<std::shared_mutex> lk(s.m);
+            n += s.ids.size();
+        }
+        return n;
+    }
+
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct Shard {
+        mutable std::shared_mutex m;
+        std::unordered_map<std::string, int> ids;
+    };
+
+    Shard& shard(const std::string& name) { return shards[std::hash<std::string>()(name) % SHARDS]; }
+    const Shard& shard(const std::string& name) const { return shards[std::hash<std::string>()(name) % SHARDS]; }
+
+    Shard shards[SHARDS];
+};
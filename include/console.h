@@ -1,4 +1,7 @@
 #pragma once
-#include "db.h"
+#include "storage.h"
 
-void console_loop(Database& db);
+class Database;
+
+// pg — то же хранилище, если это PostgreSQL: пункты про пул, реплики, планы и статистику
+void console_loop(Storage& db, Database* pg = nullptr);
@@ -1,35 +1,19 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <libpq-fe.h>
-#include <map>
-#include <fstream>
-#include <sstream>
-
-// Загрузка SQL запросов из файла
-class SqlLoader {
-public:
-    static std::map<std::string, std::string> queries;
-    
-    static void load() {
-        std::ifstream file("queries.sql");
-        std::string line;
-        while (std::getline(file, line)) {
-            if (line.empty() || line[0] == '-') continue;
-            size_t pos = line.find('=');
-            if (pos != std::string::npos) {
-                std::string key = line.substr(0, pos);
-                std::string value = line.substr(pos + 1);
-                queries[key] = value;
-            }
-        }
-    }
-    
-    static std::string get(const std::string& key) {
-        if (queries.empty()) load();
-        return queries[key];
-    }
-};
+#include "pool.h"
+#include "storage.h"
+#include "city_cache.h"
+#include "password.h"
+#include "read_replicas.h"
+#include "query_stats.h"
+#include "slow_log.h"
+#include <istream>
 
 namespace SQL {
     // Таблицы (используем IF NOT EXISTS чтобы сохранять данные)
@@ -45,14 +29,53 @@ namespace SQL {
         "city_id INTEGER REFERENCES cities(id),"
         "activity TEXT);";
     
+    // Индексы фильтров списка: (поле, id) обслуживают и фильтр, и keyset-порядок по id
+    constexpr const char* CREATE_INTEGRATORS_CITY_IDX =
+        "CREATE INDEX IF NOT EXISTS integrators_city_id_idx ON integrators(city_id, id);";
+    
+    constexpr const char* CREATE_INTEGRATORS_ACTIVITY_IDX =
+        "CREATE INDEX IF NOT EXISTS integrators_activity_idx ON integrators(activity, id);";
+    
+    // Полнотекстовый поиск: вычисляемый tsvector (russian) по названию и деятельности + GIN
+    constexpr const char* ALTER_INTEGRATORS_SEARCH_TSV =
+        "ALTER TABLE integrators ADD COLUMN IF NOT EXISTS search_tsv tsvector "
+        "GENERATED ALWAYS AS (to_tsvector('russian', coalesce(name,'') || ' ' || coalesce(activity,''))) STORED;";
+    
+    constexpr const char* CREATE_INTEGRATORS_SEARCH_IDX =
+        "CREATE INDEX IF NOT EXISTS integrators_search_idx ON integrators USING GIN(search_tsv);";
+    
+    // NOTIFY integrators_changed после любых изменений справочника (один раз на оператор)
+    constexpr const char* CREATE_NOTIFY_FUNCTION =
+        "CREATE OR REPLACE FUNCTION integrators_notify() RETURNS trigger LANGUAGE plpgsql AS $$ "
+        "BEGIN PERFORM pg_notify('integrators_changed', TG_TABLE_NAME); RETURN NULL; END $$;";
+    
+    constexpr const char* CREATE_CITIES_NOTIFY_TRIGGER =
+        "DROP TRIGGER IF EXISTS cities_notify ON cities;"
+        "CREATE TRIGGER cities_notify AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON cities "
+        "FOR EACH STATEMENT EXECUTE FUNCTION integrators_notify();";
+    
+    constexpr const char* CREATE_INTEGRATORS_NOTIFY_TRIGGER =
+        "DROP TRIGGER IF EXISTS integrators_notify ON integrators;"
+        "CREATE TRIGGER integrators_notify AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON integrators "
+        "FOR EACH STATEMENT EXECUTE FUNCTION integrators_notify();";
+    
+    // Промежуточная таблица для импорта CSV (UNLOGGED: без записи в WAL)
+    constexpr const char* CREATE_INTEGRATORS_STAGING =
+        "CREATE UNLOGGED TABLE IF NOT EXISTS integrators_staging ("
+        "name TEXT,"
+        "city TEXT,"
+        "activity TEXT);";
+    
     constexpr const char* CREATE_ADMIN = 
         "CREATE TABLE IF NOT EXISTS admin ("
         "id SERIAL PRIMARY KEY,"
         "password_hash TEXT NOT NULL);";
     
     // Города
+    // DO NOTHING + чтение существующего id: для известного города не пишется новая версия строки
     constexpr const char* INSERT_CITY = 
-        "INSERT INTO cities(name) VALUES($1) ON CONFLICT(name) DO UPDATE SET name=EXCLUDED.name RETURNING id";
+        "WITH ins AS (INSERT INTO cities(name) VALUES($1) ON CONFLICT(name) DO NOTHING RETURNING id) "
+        "SELECT id FROM ins UNION ALL SELECT id FROM cities WHERE name=$1 LIMIT 1";
     
     constexpr const char* SELECT_CITIES = "SELECT id,name FROM cities ORDER BY name";
     
@@ -74,41 +97,184 @@ namespace SQL {
     
     constexpr const char* SELECT_ADMIN_COUNT = "SELECT 1 FROM admin LIMIT 1";
     
-    constexpr const char* SELECT_ADMIN_BY_PASSWORD = "SELECT 1 FROM admin WHERE password_hash=$1";
+    constexpr const char* SELECT_ADMIN_HASH = "SELECT password_hash FROM admin LIMIT 1";
+    
+    // Замена хеша после повышения стоимости; только если пароль не сменили параллельно
+    constexpr const char* UPDATE_ADMIN_HASH = "UPDATE admin SET password_hash=$1 WHERE password_hash=$2";
 }
 
-struct City {
-    int id;
-    std::string name;
+// Результат проверки плана запроса фильтра на таблице из rows строк
+struct PlanCheck {
+    Query key;
+    int rows;
+    bool index_scan;    // integrators читается индексом своего фильтра (city_id или activity)
+    std::string plan;
+};
+
+// Декодирование результатов SELECT_INTEGRATORS / SELECT_CITIES в бинарном формате
+std::vector<Integrator> decode_integrators(const PGresult* r);
+std::vector<City> decode_cities(const PGresult* r);
+
+// Строки бинарного результата с id, name, city, activity в первых столбцах без копирования;
+// забирает r (PQclear при разрушении последней копии)
+IntegratorRows pg_integrator_rows(PGresult* r);
+
+// Итог перезагрузки queries.sql
+struct QueryReload {
+    bool ok;
+    std::string error;
+    uint64_t version;   // версия опубликованного набора (при ошибке — текущая)
+};
+
+// Сравнение текстового и бинарного декодирования результата
+struct DecodeBenchmark {
+    int rows;
+    double text_fetch_ms;
+    double text_decode_ms;
+    double binary_fetch_ms;
+    double binary_decode_ms;
 };
 
-struct Integrator {
-    int id;
-    std::string name;
-    std::string city;
-    std::string activity;
+// Столбцовое хранилище снимка в памяти
+struct SnapshotStats {
+    bool enabled;
+    size_t rows;
+    size_t cities;          // различных городов
+    size_t activities;      // различных видов деятельности
+    size_t bytes;
 };
 
-class Database {
+class AsyncDatabase;
+class Replica;
+struct Snapshot;
+
+// Хранилище в PostgreSQL: пул соединений, подготовленные запросы из queries.sql,
+// реплики для чтения и копия справочника в памяти
+class Database : public Storage {
 public:
-    Database(const std::string& conninfo);
-    ~Database();
+    // replica_cfg.conninfos — реплики для чтения; запись всегда идёт на conninfo (primary)
+    Database(const std::string& conninfo, const PoolConfig& pool_cfg = PoolConfig(),
+             const KdfConfig& kdf_cfg = KdfConfig(),
+             const ReplicaConfig& replica_cfg = ReplicaConfig());
+    ~Database() override;
 
-    void init();
-    bool has_admin();
-    void set_admin_password(const std::string& password);
-    bool check_admin_password(const std::string& password);
+    void init() override;
+    bool has_admin() override;
+    void set_admin_password(const std::string& password) override;
+    // Хеширование выполняется на пуле HashWorkers; при переполненной очереди — HashQueueFull.
+    // Хеш старого формата или меньшей стоимости после успешной проверки перезаписывается.
+    bool check_admin_password(const std::string& password) override;
 
-    int add_city(const std::string& name);
-    std::vector<City> get_cities();
-    int get_city_id(const std::string& name);
+    int add_city(const std::string& name) override;
+    std::vector<City> get_cities() override;
+    int get_city_id(const std::string& name) override;
 
     void add_integrator(const std::string& name,
                         int city_id,
-                        const std::string& activity);
+                        const std::string& activity) override;
+
+    // Upsert города и вставка интегратора одним оператором: атомарно и за один round trip.
+    // Возвращает id нового интегратора или -1.
+    // commit_token (у записей ниже тоже) — позиция WAL primary после коммита этой записи,
+    // для чтения своих записей с реплик; 0 — запись не удалась или реплик нет
+    int add_integrator_with_city(const std::string& name, const std::string& city,
+                                 const std::string& activity, uint64_t* commit_token = nullptr) override;
+
+    // Чтения с min_token идут на реплику, применившую WAL не меньше min_token
+    // (для чтения своих записей — commit_token записи), иначе на primary.
+    // С min_token = 0 — с любой реплики.
+    IntegratorRows get_integrators(uint64_t min_token = 0) override;
+
+    // До limit интеграторов с id > after_id в порядке id, с фильтром по городу/деятельности
+    IntegratorPage get_integrators_page(int after_id, int limit,
+                                        const IntegratorFilter& filter = IntegratorFilter(),
+                                        uint64_t min_token = 0) override;
+
+    // Количество интеграторов под фильтром (-1 при ошибке БД)
+    long long count_integrators(const IntegratorFilter& filter = IntegratorFilter(),
+                                uint64_t min_token = 0) override;
+
+    // Полнотекстовый поиск по названию и деятельности (websearch-синтаксис, russian)
+    SearchPage search_integrators(const std::string& query, int limit, int offset,
+                                  uint64_t min_token = 0) override;
+
+    // Проверка, что запросы фильтров остаются индексными по мере роста таблицы:
+    // на отдельном соединении создаёт временные копии cities/integrators с индексами,
+    // доращивает их до каждого из sizes (по возрастанию), делает ANALYZE и снимает EXPLAIN
+    // каждого запроса. index_scan — integrators читается индексом фильтра, а не Seq Scan
+    // или обходом первичного ключа с отбрасыванием строк
+    std::vector<PlanCheck> check_filter_plans(const std::vector<int>& sizes);
+
+    // Upsert всех городов и вставка всех интеграторов одним пакетом (pipeline)
+    // в одной транзакции. При ошибке любой строки транзакция откатывается.
+    std::vector<BatchRowResult> add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                      uint64_t* commit_token = nullptr) override;
+
+    // Импорт CSV (название,город,деятельность): COPY FROM STDIN в integrators_staging,
+    // затем одна транзакция вставляет недостающие города и переносит строки в integrators
+    ImportStats import_integrators_csv(const CsvSource& source, bool header = false,
+                                       uint64_t* commit_token = nullptr) override;
+
+    // Выгрузка COPY_INTEGRATORS_CSV (COPY TO STDOUT, FORMAT csv): куски данных
+    // копятся и передаются в sink кусками по 64 КБ. sink возвращает false, чтобы прервать.
+    bool export_integrators_csv(const CsvSink& sink) override;
 
-    std::vector<Integrator> get_integrators();
+    // Построчная выдача SELECT_INTEGRATORS без материализации всей таблицы
+    // (single-row режим libpq, chunked-rows при libpq >= 17).
+    // Колбэк возвращает false, чтобы прервать запрос. false — ошибка БД.
+    bool for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn,
+                             uint64_t min_token = 0) override;
+
+    PoolStats pool_stats() const;
+
+    // Задержки (квантили), строки, байты и ошибки по ключам queries.sql с момента запуска
+    std::vector<QueryStatsRow> query_stats() const;
+
+    // Запросы дольше cfg.threshold пишутся в ротируемый файл фоновым потоком,
+    // для первого за интервал на ключ снимается EXPLAIN (ANALYZE, BUFFERS)
+    void enable_slow_log(const SlowLogConfig& cfg);
+
+    std::vector<ReplicaStatus> replica_status() const;
+    // Размер копии справочника в памяти (enabled=false, если она выключена)
+    SnapshotStats snapshot_stats() const;
+
+    // Перечитывает queries.sql, проверяет каждый запрос PQprepare на отдельном соединении
+    // и атомарно публикует новый набор. Соединения пула переподготавливают запросы
+    // при следующем использовании. При ошибке остаётся прежний набор.
+    QueryReload reload_queries();
+
+    // Копия справочника в памяти: после вызова списки, страницы и города
+    // читаются из снимка без обращения к БД (вызывать после init)
+    void enable_replica();
+    std::shared_ptr<const Snapshot> snapshot() const;
+
+    // Асинхронный API поверх отдельных неблокирующих соединений,
+    // создаётся при первом обращении
+    AsyncDatabase& async();
+
+    // Синтетические строки формы SELECT_INTEGRATORS, декодируются обоими способами
+    DecodeBenchmark benchmark_decode(int rows);
 
 private:
-    PGconn* conn;
+    std::string conninfo;
+    PoolConfig pool_cfg;
+    ConnectionPool pool;
+    KdfConfig kdf_cfg;
+    HashWorkers hashers;
+    ReplicaConfig replica_cfg;
+    std::unique_ptr<ReadReplicas> read_replicas;
+    std::unique_ptr<SlowQueryLog> slow;
+
+    std::once_flag async_once;
+    std::unique_ptr<AsyncDatabase> async_db;
+    std::unique_ptr<Replica> replica;
+    CityCache city_cache;
+
+    std::shared_ptr<const Snapshot> load_snapshot();
+    // Возвращает позицию WAL primary (0 без реплик для чтения)
+    uint64_t after_write(const std::vector<Integrator>& rows = {}, const std::vector<City>& cities = {},
+                         bool known = true);
+    PooledConn read_conn(uint64_t min_lsn);
+    std::vector<BatchRowResult> insert_batch(const std::vector<NewIntegrator>& rows);
+    ImportStats import_csv(const CsvSource& source, bool header);
 };
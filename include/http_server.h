@@ -1,4 +1,12 @@
 #pragma once
-#include "db.h"
+#include "storage.h"
+#include "write_behind.h"
 
-void start_http_server(Database& db);
+class Database;
+
+// Потоков обработки запросов у httplib (CPPHTTPLIB_THREAD_POOL_COUNT)
+size_t http_worker_count();
+
+// writes — очередь с групповым коммитом для /admin_add (nullptr — каждая вставка своей транзакцией).
+// pg — то же хранилище, если это PostgreSQL: /stats и /admin_reload_sql есть только у него
+void start_http_server(Storage& db, WriteBehind* writes = nullptr, Database* pg = nullptr);
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Интеграторы по столбцам (struct-of-arrays) для снимка в памяти.
+// Названия лежат подряд в одной строке-арене, город и деятельность — коды словарей:
+// различных значений сотни, а строк — сотни тысяч. Фильтр сравнивает коды, а не строки,
+// и проходит по плотным массивам.
+// После заполнения хранилище не меняется; читать его можно из любых потоков.
+class IntegratorStore {
+public:
+    // 32 бита: деятельность — свободный текст, в SQLite и in-memory backend'ах
+    // различных значений может быть сколько угодно
+    using Code = uint32_t;
+
+    IntegratorStore() = default;
+    IntegratorStore(IntegratorStore&&) = default;
+    IntegratorStore& operator=(IntegratorStore&&) = default;
+    IntegratorStore(const IntegratorStore&) = delete;
+    IntegratorStore& operator=(const IntegratorStore&) = delete;
+
+    void reserve(size_t rows, size_t name_bytes);
+    // Строки добавляются в любом порядке; finish() сортирует их по id
+    void add(int id, std::string_view name, std::string_view city, std::string_view activity);
+    void finish();
+
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    int id(size_t i) const { return ids[i]; }
+    std::string_view name(size_t i) const {
+        return std::string_view(names.data() + name_off[i], name_off[i + 1] - name_off[i]);
+    }
+    std::string_view city(size_t i) const { return cities[city_codes[i]]; }
+    std::string_view activity(size_t i) const { return activities[activity_codes[i]]; }
+
+    // Код значения или nullopt, если такого значения нет ни в одной строке
+    std::optional<Code> city_code(std::string_view city) const;
+    std::optional<Code> activity_code(std::string_view activity) const;
+
+    // Первая строка с id > after_id
+    size_t upper_bound(int after_id) const;
+
+    // Номера строк начиная с from, подходящих под фильтр (nullopt — без фильтра по полю),
+    // не больше limit. Возвращает позицию, с которой продолжать сканирование.
+    size_t scan(size_t from, std::optional<Code> city, std::optional<Code> activity,
+                size_t limit, std::vector<uint32_t>& out) const;
+    size_t count(std::optional<Code> city, std::optional<Code> activity) const;
+
+    size_t name_bytes() const { return names.size(); }
+    size_t distinct_cities() const { return cities.size(); }
+    size_t distinct_activities() const { return activities.size(); }
+    // Занятая столбцами и словарями память, байт
+    size_t memory_bytes() const;
+
+private:
+    // Ключи индексов указывают в строки словаря: deque не перемещает их при росте
+    using Dict = std::deque<std::string>;
+    using Index = std::unordered_map<std::string_view, Code>;
+    static Code intern(Dict& dict, Index& index, std::string_view value);
+
+    std::vector<int32_t> ids;
+    std::vector<uint32_t> name_off{0};      // name(i) = names[name_off[i], name_off[i + 1])
+    std::string names;
+    std::vector<Code> city_codes;
+    std::vector<Code> activity_codes;
+
+    Dict cities;
+    Dict activities;
+    Index city_index;
+    Index activity_index;
+};
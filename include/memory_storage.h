@@ -0,0 +1,63 @@
+#pragma once
+#include "storage.h"
+#include "password.h"
+#include <shared_mutex>
+#include <unordered_map>
+
+// Хранилище в памяти процесса, без БД: для нагрузочных тестов HTTP и разработки.
+// Данные пропадают при выходе. Записи копятся в pending, а читатели получают неизменяемый
+// набор столбцовых частей. Первое чтение после записей собирает из pending новую часть;
+// соседние части сливаются, когда младшая дорастает до половины старшей, так что частей
+// O(log n), а каждая строка копируется O(log n) раз за всё время, без пересборки всего.
+class MemoryStorage : public Storage {
+public:
+    explicit MemoryStorage(const KdfConfig& kdf_cfg = KdfConfig());
+
+    void init() override {}
+    bool has_admin() override;
+    void set_admin_password(const std::string& password) override;
+    bool check_admin_password(const std::string& password) override;
+
+    int add_city(const std::string& name) override;
+    std::vector<City> get_cities() override;
+    int get_city_id(const std::string& name) override;
+
+    void add_integrator(const std::string& name, int city_id, const std::string& activity) override;
+    int add_integrator_with_city(const std::string& name, const std::string& city,
+                                 const std::string& activity, uint64_t* commit_token = nullptr) override;
+
+    IntegratorRows get_integrators(uint64_t min_token = 0) override;
+    IntegratorPage get_integrators_page(int after_id, int limit,
+                                        const IntegratorFilter& filter = IntegratorFilter(),
+                                        uint64_t min_token = 0) override;
+    long long count_integrators(const IntegratorFilter& filter = IntegratorFilter(),
+                                uint64_t min_token = 0) override;
+    // Подстрока в названии или деятельности; rank 1 — в названии, 0.5 — только в деятельности
+    SearchPage search_integrators(const std::string& query, int limit, int offset,
+                                  uint64_t min_token = 0) override;
+
+    std::vector<BatchRowResult> add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                      uint64_t* commit_token = nullptr) override;
+    ImportStats import_integrators_csv(const CsvSource& source, bool header = false,
+                                       uint64_t* commit_token = nullptr) override;
+    bool export_integrators_csv(const CsvSink& sink) override;
+    bool for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn,
+                             uint64_t min_token = 0) override;
+
+private:
+    std::shared_ptr<const IntegratorSet> current();
+    // Вызываются под уникальной блокировкой m
+    int city_locked(const std::string& name);
+    int insert_locked(const std::string& name, const std::string& city, const std::string& activity);
+
+    KdfConfig kdf_cfg;
+    HashWorkers hashers;
+
+    std::shared_mutex m;
+    std::string admin;
+    std::vector<City> cities;                       // id = индекс + 1
+    std::unordered_map<std::string, int> city_ids;
+    int last_id = 0;
+    std::vector<Integrator> pending;                // ещё не в частях, по возрастанию id
+    std::shared_ptr<const IntegratorSet> published = std::make_shared<IntegratorSet>();
+};
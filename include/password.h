@@ -0,0 +1,84 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+
+// Хеширование пароля администратора: PBKDF2-HMAC-SHA256 (OpenSSL EVP) со случайной солью.
+// Хранится вместе с параметрами: "pbkdf2-sha256$<итерации>$<соль hex>$<хеш hex>",
+// так что стоимость можно поднять без сброса пароля.
+struct KdfConfig {
+    int iterations = 200000;
+    size_t threads = 2;        // воркеры хеширования
+    // Задач сверх занятых воркеров. Каждая держит поток httplib, ждущий результата,
+    // поэтому threads + queue_limit должно быть заметно меньше пула httplib:
+    // main берёт половину http_worker_count()
+    size_t queue_limit = 2;
+};
+
+std::string hash_password(const std::string& password, int iterations);
+
+// Проверка по сохранённой строке. Поддерживает старые форматы: hex несолёного SHA-256
+// и simple_hash из первых версий (записан в поставляемом integrators.db).
+// needs_rehash — хеш старого формата или с меньшим числом итераций, чем iterations.
+bool verify_password(const std::string& password, const std::string& stored,
+                     int iterations, bool& needs_rehash);
+
+// Сохранённая строка в одном из форматов, которые умеет проверять verify_password.
+// Иначе войти с ней нельзя — пароль стоит задать заново
+bool password_hash_supported(const std::string& stored);
+
+// Очередь хеширования переполнена (поток логинов) — запрос стоит отклонить
+struct HashQueueFull : std::runtime_error {
+    HashQueueFull() : std::runtime_error("password hashing queue is full") {}
+};
+
+// Небольшой пул потоков для дорогого хеширования: потоки httplib не занимаются
+// PBKDF2 сами. Принятых задач (в очереди и выполняемых) не больше threads + queue_limit,
+// лишние отклоняются сразу — так ждущие хеша занимают лишь часть потоков httplib.
+class HashWorkers {
+public:
+    HashWorkers(size_t threads, size_t queue_limit);
+    ~HashWorkers();
+
+    HashWorkers(const HashWorkers&) = delete;
+    HashWorkers& operator=(const HashWorkers&) = delete;
+
+    // false — принято уже threads + queue_limit задач, эта не принята
+    bool submit(std::function<void()> job);
+
+private:
+    void run();
+
+    size_t limit;
+    size_t in_flight = 0;       // в очереди и выполняются
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+// Итог проверки пароля; rehash — новый хеш, если сохранённый пора перезаписать
+struct PasswordCheck {
+    bool ok;
+    std::string rehash;
+};
+
+// verify_password (и новый хеш при повышении стоимости) на пуле workers;
+// вызывающий ждёт результат. При переполненной очереди — HashQueueFull
+PasswordCheck check_password(HashWorkers& workers, const std::string& password,
+                             const std::string& stored, int iterations);
+
+// Скорость хеширования при разной стоимости — для подбора KdfConfig::iterations
+struct KdfBenchmark {
+    int iterations;
+    double hashes_per_sec;
+    double ms_per_hash;
+};
+
+std::vector<KdfBenchmark> benchmark_kdf(const std::vector<int>& iterations);
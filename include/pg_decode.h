@@ -0,0 +1,42 @@
+#pragma once
+#include <libpq-fe.h>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+// Декодирование полей результата, полученного в бинарном формате (resultFormat=1).
+// Числа приходят в сетевом порядке байт, текст — как длина + указатель без '\0'-поиска.
+
+inline uint32_t pg_be32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | uint32_t(u[3]);
+}
+
+inline uint64_t pg_be64(const char* p) {
+    return (uint64_t(pg_be32(p)) << 32) | pg_be32(p + 4);
+}
+
+// int4/int8 по фактической длине поля; NULL -> 0
+inline int64_t pg_int(const PGresult* r, int row, int col) {
+    const char* p = PQgetvalue(r, row, col);
+    switch (PQgetlength(r, row, col)) {
+        case 2: return int16_t((uint8_t(p[0]) << 8) | uint8_t(p[1]));
+        case 4: return int32_t(pg_be32(p));
+        case 8: return int64_t(pg_be64(p));
+        default: return 0;
+    }
+}
+
+// float4 (например ts_rank)
+inline float pg_float4(const PGresult* r, int row, int col) {
+    if (PQgetlength(r, row, col) != 4) return 0;
+    uint32_t bits = pg_be32(PQgetvalue(r, row, col));
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// text/varchar: указатель внутрь PGresult, действителен до PQclear; NULL -> пустая строка
+inline std::string_view pg_text(const PGresult* r, int row, int col) {
+    return std::string_view(PQgetvalue(r, row, col), PQgetlength(r, row, col));
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <libpq-fe.h>
+#include <string>
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include "queries.h"
+
+// Настройки пула соединений
+struct PoolConfig {
+    size_t min_size = 2;                                  // открываются при старте
+    size_t max_size = 8;                                  // верхняя граница
+    std::chrono::milliseconds checkout_timeout{5000};     // ожидание свободного соединения
+    std::chrono::seconds idle_check{30};                  // после такого простоя соединение проверяется SELECT 1
+    size_t async_connections = 4;                         // соединений асинхронного API (Database::async)
+};
+
+// Счётчики пула (для подбора размера под нагрузкой)
+struct PoolStats {
+    size_t size = 0;             // открыто соединений
+    size_t in_use = 0;           // выдано сейчас
+    size_t peak_in_use = 0;      // максимум выданных одновременно
+    size_t max_size = 0;
+    uint64_t checkouts = 0;      // всего выдач
+    uint64_t waits = 0;          // выдач, которым пришлось ждать
+    uint64_t timeouts = 0;       // отказов по таймауту
+    uint64_t resets = 0;         // PQreset сломанных соединений
+    uint64_t wait_ns_total = 0;  // суммарное время ожидания
+    uint64_t wait_ns_max = 0;
+    uint64_t busy_ns_total = 0;  // суммарное время удержания соединений
+    double uptime_s = 0;
+
+    // Доля занятости пула за время работы: busy / (uptime * max_size)
+    double utilization() const {
+        if (uptime_s <= 0 || max_size == 0) return 0;
+        return busy_ns_total / 1e9 / (uptime_s * max_size);
+    }
+};
+
+class ConnectionPool;
+
+// Соединение пула вместе с отметками подготовленных на нём запросов (по Query)
+struct PgConn {
+    PGconn* conn;
+    std::bitset<QUERY_COUNT> prepared;
+    std::chrono::steady_clock::time_point last_used;
+    uint64_t sql_version = 0;  // версия queries.sql, из которой подготовлены запросы
+    bool setup_done = false;   // on_connect уже выполнен для этого соединения
+};
+
+// Соединение, взятое из пула. Возвращается в пул в деструкторе.
+class PooledConn {
+public:
+    PooledConn(ConnectionPool* pool, PgConn* conn);
+    PooledConn(PooledConn&& other) noexcept;
+    PooledConn(const PooledConn&) = delete;
+    PooledConn& operator=(const PooledConn&) = delete;
+    PooledConn& operator=(PooledConn&&) = delete;
+    ~PooledConn();
+
+    PGconn* get() const { return conn->conn; }
+    operator PGconn*() const { return conn->conn; }
+    PgConn& entry() const { return *conn; }
+
+private:
+    ConnectionPool* pool;
+    PgConn* conn;
+    std::chrono::steady_clock::time_point taken;
+};
+
+class ConnectionPool {
+public:
+    ConnectionPool(const std::string& conninfo, const PoolConfig& cfg);
+    ~ConnectionPool();
+
+    // Бросает std::runtime_error, если за checkout_timeout соединение не освободилось
+    PooledConn acquire();
+    PoolStats stats() const;
+
+    // Вызывается для каждого нового и восстановленного (PQreset) соединения,
+    // а при установке — для всех уже открытых свободных соединений
+    void set_on_connect(std::function<void(PgConn&)> fn);
+
+private:
+    friend class PooledConn;
+
+    PGconn* connect();
+    bool ensure_healthy(PgConn& e);
+    void reset(PgConn& e);
+    void release(PgConn* conn, std::chrono::steady_clock::duration held);
+
+    std::string conninfo;
+    PoolConfig cfg;
+    std::chrono::steady_clock::time_point started;
+
+    mutable std::mutex m;
+    std::condition_variable cv;
+    std::function<void(PgConn&)> on_connect;
+    std::vector<std::unique_ptr<PgConn>> idle;
+    size_t total = 0;
+    PoolStats counters;
+};
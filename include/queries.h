@@ -0,0 +1,104 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+// Ключи queries.sql. Каждый обязателен: без него приложение не запустится.
+// Имя ключа — и имя подготовленного запроса на сервере.
+#define SQL_QUERIES(X)                          \
+    X(CREATE_CITIES)                            \
+    X(CREATE_INTEGRATORS)                       \
+    X(CREATE_INTEGRATORS_CITY_IDX)              \
+    X(CREATE_INTEGRATORS_ACTIVITY_IDX)          \
+    X(ALTER_INTEGRATORS_SEARCH_TSV)             \
+    X(CREATE_INTEGRATORS_SEARCH_IDX)            \
+    X(CREATE_NOTIFY_FUNCTION)                   \
+    X(CREATE_CITIES_NOTIFY_TRIGGER)             \
+    X(CREATE_INTEGRATORS_NOTIFY_TRIGGER)        \
+    X(CREATE_INTEGRATORS_STAGING)               \
+    X(CREATE_ADMIN)                             \
+    X(INSERT_CITY)                              \
+    X(SELECT_CITIES)                            \
+    X(SELECT_CITY_BY_NAME)                      \
+    X(INSERT_INTEGRATOR)                        \
+    X(ADD_INTEGRATOR_WITH_CITY)                 \
+    X(INSERT_INTEGRATOR_BY_CITY_NAME)           \
+    X(SELECT_INTEGRATORS)                       \
+    X(SELECT_INTEGRATORS_PAGE)                  \
+    X(SELECT_INTEGRATORS_PAGE_BY_CITY)          \
+    X(SELECT_INTEGRATORS_PAGE_BY_ACTIVITY)      \
+    X(SELECT_INTEGRATORS_PAGE_BY_CITY_ACTIVITY) \
+    X(COUNT_INTEGRATORS)                        \
+    X(SEARCH_INTEGRATORS)                       \
+    X(IMPORT_TRUNCATE_STAGING)                  \
+    X(COPY_STAGING_CSV)                         \
+    X(COPY_STAGING_CSV_HEADER)                  \
+    X(IMPORT_MERGE_CITIES)                      \
+    X(IMPORT_MERGE_INTEGRATORS)                 \
+    X(COPY_INTEGRATORS_CSV)                     \
+    X(TX_BEGIN)                                 \
+    X(TX_BEGIN_SNAPSHOT)                        \
+    X(TX_COMMIT)                                \
+    X(TX_ROLLBACK)                              \
+    X(INSERT_ADMIN)                             \
+    X(DELETE_ADMIN)                             \
+    X(SELECT_ADMIN_COUNT)                       \
+    X(SELECT_ADMIN_HASH)                        \
+    X(UPDATE_ADMIN_HASH)                        \
+    X(BENCH_INTEGRATORS)                        \
+    X(PRIMARY_WAL_LSN)                          \
+    X(REPLICA_STATUS)
+
+enum class Query : int {
+#define X(key) key,
+    SQL_QUERIES(X)
+#undef X
+};
+
+constexpr size_t QUERY_COUNT = 0
+#define X(key) + 1
+    SQL_QUERIES(X)
+#undef X
+    ;
+
+// SQL из queries.sql: неизменяемая таблица по Query. Текущая таблица публикуется
+// атомарным указателем — get на горячем пути не берёт блокировок, это загрузка
+// указателя и индексация массива. При перезагрузке прежняя таблица освобождается
+// не сразу, а при следующих публикациях спустя минуту: строка из get действительна
+// на время вызова, в котором её передали (PQprepare, PQexec, копирование), но хранить
+// указатель дольше нельзя.
+class SqlLoader {
+public:
+    struct Table {
+        uint64_t version = 0;
+        std::string sql[QUERY_COUNT];
+    };
+
+    // Загрузка при старте: runtime_error, если файла нет или не хватает ключа
+    static void load() { table(); }
+
+    static const char* get(Query q) { return table().sql[int(q)].c_str(); }
+    static std::string_view view(Query q) { return table().sql[int(q)]; }
+    static uint64_t version() { return table().version; }
+
+    // Разбор файла без публикации (для проверки перед перезагрузкой)
+    static std::unique_ptr<Table> read(const char* path = "queries.sql");
+    // Публикация нового набора, возвращает его версию
+    static uint64_t publish(std::unique_ptr<Table> t);
+
+    static const char* name(Query q);
+
+    // DDL выполняется один раз в init, COPY и TX_ — через PQexec; они не готовятся
+    static bool preparable(Query q);
+
+private:
+    static const Table& table() {
+        const Table* t = current.load(std::memory_order_acquire);
+        return t ? *t : load_once();
+    }
+    static const Table& load_once();
+
+    static std::atomic<const Table*> current;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "queries.h"
+#include <libpq-fe.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Гистограмма задержек в духе HDR: логарифмические корзины, каждая делится на 8
+// линейных (погрешность квантилей ~12%). Значения — в микросекундах, до 2^36 (~19 ч).
+// Запись — одно relaxed-увеличение атомарного счётчика, без блокировок.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 3;
+    static constexpr int SUB = 1 << SUB_BITS;
+    static constexpr int BUCKETS = 2 * SUB + (35 - SUB_BITS) * SUB;
+
+    void record(uint64_t us) { counts[index(us)].fetch_add(1, std::memory_order_relaxed); }
+
+    // Квантиль q (0..1) по копии счётчиков: верхняя граница корзины, мкс
+    static uint64_t quantile(const std::vector<uint64_t>& counts, double q);
+    std::vector<uint64_t> counts_snapshot() const;
+
+    static int index(uint64_t us);
+    static uint64_t upper_bound(int index);
+
+private:
+    std::atomic<uint64_t> counts[BUCKETS] = {};
+};
+
+// Сводка по одному ключу queries.sql
+struct QueryStatsRow {
+    Query key;
+    uint64_t count;
+    uint64_t errors;
+    uint64_t rows;
+    uint64_t bytes;      // получено данных (сумма длин полей результата)
+    double mean_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+};
+
+// Счётчики по ключам queries.sql: задержка, строки, байты, ошибки
+class QueryStats {
+public:
+    using Duration = std::chrono::steady_clock::duration;
+
+    void record(Query key, Duration d, uint64_t rows, uint64_t bytes, bool error);
+    // По результату запроса: строки, байты и статус берутся из PGresult (NULL — ошибка)
+    void record(Query key, Duration d, const PGresult* r);
+
+    // Ключи, по которым были запросы
+    std::vector<QueryStatsRow> snapshot() const;
+
+private:
+    struct Metrics {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> rows{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint64_t> max_us{0};
+        LatencyHistogram latency;
+    };
+
+    Metrics metrics[QUERY_COUNT];
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Реплики для чтения (потоковая репликация PostgreSQL)
+struct ReplicaConfig {
+    std::vector<std::string> conninfos;
+    std::chrono::milliseconds max_lag{5000};          // отстающая сильнее реплика не получает чтений
+    std::chrono::milliseconds check_interval{1000};   // период проверки здоровья и отставания
+    size_t pool_size = 8;                             // соединений на реплику
+};
+
+struct ReplicaStatus {
+    std::string conninfo;
+    bool healthy;
+    uint64_t replay_lsn;
+    double lag_ms;          // по времени последней применённой транзакции
+    uint64_t lag_bytes;     // от текущей позиции WAL primary
+};
+
+// "16/B374D848" -> 0x16B374D848; 0 для пустой или неверной строки
+uint64_t parse_lsn(const char* s);
+
+// Выбор реплики для чтения. Фоновый поток раз в check_interval опрашивает
+// primary (позиция WAL) и каждую реплику (применённая позиция, отставание)
+// отдельными соединениями. pick раздаёт здоровые реплики по кругу.
+class ReadReplicas {
+public:
+    ReadReplicas(const std::string& primary_conninfo, const ReplicaConfig& cfg,
+                 std::function<void(PgConn&)> on_connect);
+    ~ReadReplicas();
+
+    ReadReplicas(const ReadReplicas&) = delete;
+    ReadReplicas& operator=(const ReadReplicas&) = delete;
+
+    // Пул реплики, применившей WAL не меньше min_lsn; nullptr — читать с primary
+    ConnectionPool* pick(uint64_t min_lsn);
+
+    // Соединение не выдалось — реплика выключается до следующей проверки
+    void mark_down(ConnectionPool* pool);
+
+    std::vector<ReplicaStatus> status() const;
+
+private:
+    struct Node {
+        std::string conninfo;
+        std::unique_ptr<ConnectionPool> pool;
+        PGconn* probe = nullptr;
+        std::atomic<bool> healthy{false};
+        std::atomic<uint64_t> replay_lsn{0};
+        std::atomic<uint64_t> lag_bytes{0};
+        std::atomic<double> lag_ms{0};
+    };
+
+    void run();
+    void check(Node& n, uint64_t primary_lsn);
+
+    std::string primary_conninfo;
+    ReplicaConfig cfg;
+    std::vector<std::unique_ptr<Node>> nodes;
+    PGconn* primary_probe = nullptr;
+    std::atomic<size_t> next{0};
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread checker;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include "db.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Неизменяемый снимок справочника: города (по имени) и интеграторы по столбцам.
+// integrators — загруженное хранилище и, если есть, вторая часть со своими записями,
+// ещё не пришедшими с перезагрузкой
+struct Snapshot {
+    std::vector<City> cities;
+    IntegratorSet integrators;
+};
+
+// Копия cities/integrators в памяти.
+// Читатели берут текущий снимок атомарной загрузкой shared_ptr, без блокировок;
+// снимок не меняется, новый публикуется целиком (RCU). Отдельное соединение
+// слушает NOTIFY от триггеров на таблицах и пересобирает снимок после изменений —
+// так согласованы все экземпляры приложения, работающие с одной БД.
+// Свои записи приложение добавляет в снимок сразу (apply), не дожидаясь перезагрузки.
+class Replica {
+public:
+    using Loader = std::function<std::shared_ptr<const Snapshot>()>;
+
+    // Подключается, выполняет LISTEN и загружает первый снимок до возврата
+    Replica(const std::string& conninfo, Loader load);
+    ~Replica();
+
+    Replica(const Replica&) = delete;
+    Replica& operator=(const Replica&) = delete;
+
+    std::shared_ptr<const Snapshot> current() const { return std::atomic_load(&snap); }
+
+    // Добавляет закоммиченные строки и города в небольшую вторую часть снимка:
+    // чтение своих записей без полной перезагрузки. Строки, уже попавшие
+    // в снимок, пропускаются; при перезагрузке в новый снимок переносятся только
+    // записи, применённые после начала загрузки.
+    void apply(const std::vector<Integrator>& rows, const std::vector<City>& cities);
+
+    // Для записей, строки которых неизвестны (COPY): ждёт снимок, загрузка которого
+    // началась после вызова. false и запись в лог — не дождались за timeout
+    bool sync(std::chrono::milliseconds timeout = std::chrono::milliseconds(2000));
+
+    uint64_t reloads() const { return reload_count; }
+
+    static constexpr const char* CHANNEL = "integrators_changed";
+
+private:
+    bool connect();
+    void reload();
+    void run();
+    // Под publish_m: снимок из base и ещё не вошедших в него rows/cities
+    void publish(std::shared_ptr<const Snapshot> base, const std::vector<Integrator>& rows,
+                 const std::vector<City>& cities);
+
+    std::string conninfo;
+    Loader load;
+    PGconn* conn = nullptr;
+    int wake_fd[2] = {-1, -1};
+
+    std::shared_ptr<const Snapshot> snap;
+    std::mutex publish_m;     // apply и перезагрузка не перетирают снимки друг друга
+
+    // Под publish_m: записи apply по порядку; перезагрузка отбрасывает те,
+    // что применены до её начала
+    struct Applied {
+        uint64_t seq;
+        std::vector<Integrator> rows;
+        std::vector<City> cities;
+    };
+    std::deque<Applied> applied;
+    uint64_t apply_seq = 0;
+    std::atomic<uint64_t> reload_count{0};
+
+    std::mutex m;
+    std::condition_variable cv;
+    uint64_t requested = 0;   // номер последнего запроса sync
+    uint64_t completed = 0;   // запросы с номером <= completed уже видны в снимке
+
+    std::atomic<bool> stopping{false};
+    std::thread listener;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+
+// Сессии администратора: случайный токен -> момент истечения.
+// Проверка токена — поиск в хеш-таблице одного из шардов, без обращения к БД.
+// Истёкшие записи удаляются лениво: при проверке и попутной чисткой шарда
+// при выдаче нового токена.
+class SessionStore {
+public:
+    explicit SessionStore(std::chrono::seconds ttl = std::chrono::hours(8));
+
+    // Новый токен: 32 случайных байта (RAND_bytes) в hex
+    std::string create();
+    bool validate(const std::string& token);
+    void remove(const std::string& token);
+
+    // commit_token последней записи сессии (у PostgreSQL — позиция WAL):
+    // её чтения пойдут только на догнавшие реплики
+    void note_write(const std::string& token, uint64_t lsn);
+    uint64_t write_lsn(const std::string& token);
+    size_t size() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t SHARDS = 16;
+
+    struct Session {
+        Clock::time_point expires;
+        uint64_t write_lsn = 0;
+    };
+
+    struct Shard {
+        mutable std::mutex m;
+        std::unordered_map<std::string, Session> sessions;
+    };
+
+    Shard& shard(const std::string& token) { return shards[std::hash<std::string>()(token) % SHARDS]; }
+
+    std::chrono::seconds ttl;
+    Shard shards[SHARDS];
+};
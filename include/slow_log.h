@@ -0,0 +1,76 @@
+#pragma once
+#include "queries.h"
+#include <libpq-fe.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Журнал медленных запросов
+struct SlowLogConfig {
+    std::chrono::milliseconds threshold{200};       // запросы не быстрее этого попадают в журнал
+    std::string path = "slow_queries.log";
+    size_t max_bytes = 10 * 1024 * 1024;            // после этого размера файл ротируется
+    int keep_files = 3;                             // path.1 .. path.N
+    std::chrono::seconds explain_interval{60};      // EXPLAIN — не чаще раза за интервал на ключ
+    size_t queue_limit = 1000;                      // записи сверх лимита отбрасываются
+};
+
+// Запись в журнал и снятие плана идут в фоновом потоке: поток запроса только
+// копирует параметры в очередь. Для первого медленного запроса ключа за интервал
+// фоновый поток выполняет EXPLAIN (ANALYZE, BUFFERS) на своём соединении
+// внутри BEGIN/ROLLBACK — изменения от ANALYZE пишущих запросов откатываются.
+class SlowQueryLog {
+public:
+    SlowQueryLog(const std::string& conninfo, const SlowLogConfig& cfg);
+    ~SlowQueryLog();
+
+    SlowQueryLog(const SlowQueryLog&) = delete;
+    SlowQueryLog& operator=(const SlowQueryLog&) = delete;
+
+    std::chrono::steady_clock::duration threshold() const { return cfg.threshold; }
+
+    void submit(Query key, int n_params, const char* const* values,
+                std::chrono::steady_clock::duration took, long long rows);
+
+    uint64_t dropped() const { return drop_count; }
+
+private:
+    struct Entry {
+        Query key;
+        // Полные значения (nullopt — NULL): EXPLAIN выполняется с ними же,
+        // обрезаются только при записи строки журнала
+        std::vector<std::optional<std::string>> params;
+        double ms;
+        long long rows;
+        std::chrono::system_clock::time_point at;
+        bool explain;
+    };
+
+    void run();
+    void write(const Entry& e);
+    std::string explain(const Entry& e);
+    void rotate();
+
+    std::string conninfo;
+    SlowLogConfig cfg;
+    std::ofstream out;
+    size_t written = 0;
+    PGconn* side = nullptr;  // соединение для EXPLAIN, открывается при первой необходимости
+
+    // Время последнего EXPLAIN по ключу (steady_clock, нс; 0 — ещё не было)
+    std::atomic<int64_t> last_explain[QUERY_COUNT] = {};
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Entry> queue;
+    bool stopping = false;
+    std::atomic<uint64_t> drop_count{0};
+    std::thread writer;
+};
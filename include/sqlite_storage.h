@@ -0,0 +1,107 @@
+#pragma once
+#include "storage.h"
+#include "password.h"
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+struct SqliteConfig {
+    std::string path = "integrators.db";
+    size_t readers = 4;                                     // соединений для чтения
+    std::chrono::milliseconds busy_timeout{5000};           // ожидание блокировки файла
+};
+
+// Встроенное хранилище для одного узла: файл SQLite в режиме WAL.
+// Схема совместима с integrators.db из репозитория (integrators.city — текст,
+// деятельность — description, хеш пароля — в kv), таблица cities добавляется к ней.
+// Одно соединение пишет (под мьютексом), несколько читают параллельно — WAL
+// не блокирует чтения записью. Все операторы подготавливаются один раз на соединение.
+class SqliteStorage : public Storage {
+public:
+    explicit SqliteStorage(const SqliteConfig& cfg = SqliteConfig(), const KdfConfig& kdf_cfg = KdfConfig());
+    ~SqliteStorage() override;
+
+    SqliteStorage(const SqliteStorage&) = delete;
+    SqliteStorage& operator=(const SqliteStorage&) = delete;
+
+    void init() override;
+    bool has_admin() override;
+    void set_admin_password(const std::string& password) override;
+    bool check_admin_password(const std::string& password) override;
+
+    int add_city(const std::string& name) override;
+    std::vector<City> get_cities() override;
+    int get_city_id(const std::string& name) override;
+
+    void add_integrator(const std::string& name, int city_id, const std::string& activity) override;
+    int add_integrator_with_city(const std::string& name, const std::string& city,
+                                 const std::string& activity, uint64_t* commit_token = nullptr) override;
+
+    IntegratorRows get_integrators(uint64_t min_token = 0) override;
+    IntegratorPage get_integrators_page(int after_id, int limit,
+                                        const IntegratorFilter& filter = IntegratorFilter(),
+                                        uint64_t min_token = 0) override;
+    long long count_integrators(const IntegratorFilter& filter = IntegratorFilter(),
+                                uint64_t min_token = 0) override;
+    // Подстрока в названии или деятельности (LIKE); rank 1 — в названии, 0.5 — только в деятельности
+    SearchPage search_integrators(const std::string& query, int limit, int offset,
+                                  uint64_t min_token = 0) override;
+
+    std::vector<BatchRowResult> add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                      uint64_t* commit_token = nullptr) override;
+    ImportStats import_integrators_csv(const CsvSource& source, bool header = false,
+                                       uint64_t* commit_token = nullptr) override;
+    bool export_integrators_csv(const CsvSink& sink) override;
+    bool for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn,
+                             uint64_t min_token = 0) override;
+
+private:
+    enum Stmt {
+        BEGIN, COMMIT, ROLLBACK,
+        INSERT_CITY, SELECT_CITY_BY_NAME, SELECT_CITY_NAME, SELECT_CITIES,
+        INSERT_INTEGRATOR,
+        SELECT_INTEGRATORS,
+        SELECT_PAGE, SELECT_PAGE_BY_CITY, SELECT_PAGE_BY_ACTIVITY, SELECT_PAGE_BY_CITY_ACTIVITY,
+        COUNT_INTEGRATORS, SEARCH_INTEGRATORS,
+        SELECT_ADMIN_HASH, SET_ADMIN_HASH, UPDATE_ADMIN_HASH,
+        STMT_COUNT
+    };
+
+    struct Conn {
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmts[STMT_COUNT] = {};
+    };
+
+    // Соединение для чтения на время области видимости
+    class Reader {
+    public:
+        explicit Reader(SqliteStorage& s);
+        ~Reader();
+        Conn& operator*() { return *c; }
+    private:
+        SqliteStorage& s;
+        Conn* c;
+    };
+
+    Conn* open(bool read_only);
+    void close(Conn* c);
+    sqlite3_stmt* stmt(Conn& c, Stmt s);
+    bool exec(Conn& c, Stmt s);     // оператор без параметров и строк результата
+    int city_id(Conn& c, const std::string& name);
+    int insert_city(Conn& c, const std::string& name);
+    std::vector<BatchRowResult> insert_rows(const std::vector<NewIntegrator>& rows, std::string& first_error);
+    std::string admin_hash();
+
+    SqliteConfig cfg;
+    KdfConfig kdf_cfg;
+    HashWorkers hashers;
+
+    std::mutex write_mutex;
+    Conn* writer = nullptr;
+
+    std::mutex readers_mutex;
+    std::condition_variable readers_cv;
+    std::vector<Conn*> readers;         // все соединения для чтения
+    std::vector<Conn*> idle_readers;
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <istream>
+#include "integrator_store.h"
+
+// Общий интерфейс хранилища справочника: PostgreSQL (Database), SQLite (SqliteStorage)
+// и память процесса (MemoryStorage). HTTP-сервер и консоль работают только через него.
+
+struct City {
+    int id;
+    std::string name;
+};
+
+struct Integrator {
+    int id;
+    std::string name;
+    std::string city;
+    std::string activity;
+};
+
+// Строка интегратора без копирования: поля указывают внутрь результата запроса
+// или хранилища и действительны только во время вызова колбэка
+struct IntegratorRef {
+    int id;
+    std::string_view name;
+    std::string_view city;
+    std::string_view activity;
+};
+
+// Строки интеграторов без копирования полей. Разделяет владение источником
+// (столбцовым хранилищем или результатом запроса конкретного backend'а) и читает
+// строку по номеру через row; выдаёт все строки источника или выбранные номера.
+// IntegratorRef из неё действительны, пока жива IntegratorRows.
+class IntegratorRows {
+public:
+    using RowFn = IntegratorRef (*)(const void* owner, size_t row);
+
+    IntegratorRows() = default;
+    IntegratorRows(std::shared_ptr<const void> owner, RowFn row, size_t count)
+        : owner(std::move(owner)), row(row), count(count) {}
+    IntegratorRows(std::shared_ptr<const void> owner, RowFn row, std::vector<uint32_t> rows)
+        : owner(std::move(owner)), row(row), selected(std::move(rows)), use_selected(true),
+          count(selected.size()) {}
+    explicit IntegratorRows(std::shared_ptr<const IntegratorStore> s)
+        : IntegratorRows(s, store_row, s ? s->size() : 0) {}
+    IntegratorRows(std::shared_ptr<const IntegratorStore> s, std::vector<uint32_t> rows)
+        : IntegratorRows(std::move(s), store_row, std::move(rows)) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    IntegratorRef operator[](size_t i) const { return row(owner.get(), use_selected ? selected[i] : i); }
+    IntegratorRef back() const { return (*this)[count - 1]; }
+
+    // Оставить только первые n строк
+    void truncate(size_t n) { if (n < count) count = n; }
+
+    struct iterator {
+        const IntegratorRows* rows;
+        size_t i;
+        IntegratorRef operator*() const { return (*rows)[i]; }
+        iterator& operator++() { ++i; return *this; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+    };
+    iterator begin() const { return {this, 0}; }
+    iterator end() const { return {this, count}; }
+
+private:
+    static IntegratorRef store_row(const void* owner, size_t i) {
+        auto s = static_cast<const IntegratorStore*>(owner);
+        return {s->id(i), s->name(i), s->city(i), s->activity(i)};
+    }
+
+    std::shared_ptr<const void> owner;
+    RowFn row = nullptr;
+    std::vector<uint32_t> selected;
+    bool use_selected = false;
+    size_t count = 0;
+};
+
+// Фильтр списка: пустая строка — без фильтра по полю
+struct IntegratorFilter {
+    std::string city;
+    std::string activity;
+};
+
+// Страница списка интеграторов (keyset по id)
+struct IntegratorPage {
+    IntegratorRows items;
+    int next_after;     // курсор следующей страницы, -1 если страница последняя
+    bool ok = true;     // false — ошибка чтения, items пуст
+};
+
+// Страница результатов поиска (по убыванию релевантности)
+struct SearchPage {
+    IntegratorRows items;
+    std::vector<float> ranks;   // ts_rank для items[i]
+    int next_offset;            // смещение следующей страницы, -1 если страница последняя
+    bool ok = true;             // false — ошибка поиска, items пуст
+};
+
+// Новый интегратор для пакетной вставки (город задаётся именем)
+struct NewIntegrator {
+    std::string name;
+    std::string city;
+    std::string activity;
+};
+
+// Результат строки пакета: id новой записи или текст ошибки
+struct BatchRowResult {
+    int id;             // -1 если строка не вставлена
+    std::string error;
+};
+
+// Строки "название<TAB>город<TAB>деятельность", пустые строки пропускаются
+std::vector<NewIntegrator> parse_integrators_tsv(std::istream& in);
+
+// Источник CSV для импорта: передаёт в sink кусок за куском,
+// возвращает false, если чтение прервалось
+using CsvSink = std::function<bool(const char* data, size_t len)>;
+using CsvSource = std::function<bool(const CsvSink& sink)>;
+
+// Итог импорта CSV
+struct ImportStats {
+    bool ok;
+    std::string error;
+    long long rows;     // добавлено интеграторов
+    double seconds;
+
+    double rows_per_sec() const { return seconds > 0 ? rows / seconds : 0; }
+};
+
+class Storage {
+public:
+    virtual ~Storage() = default;
+
+    // Создание схемы; вызывается один раз до остальных методов
+    virtual void init() = 0;
+    virtual bool has_admin() = 0;
+    virtual void set_admin_password(const std::string& password) = 0;
+    // При переполненной очереди хеширования — HashQueueFull
+    virtual bool check_admin_password(const std::string& password) = 0;
+
+    virtual int add_city(const std::string& name) = 0;
+    virtual std::vector<City> get_cities() = 0;
+    virtual int get_city_id(const std::string& name) = 0;
+
+    // Чтение своих записей. Запись отдаёт в *commit_token (если не nullptr) метку,
+    // с которой её результат виден; чтение с min_token не вернёт данные старее этой метки.
+    // 0 — без требований. У PostgreSQL метка — LSN коммита, чтение идёт на реплику,
+    // догнавшую его. SQLite и память всегда читают актуальные данные: метка 0, min_token не нужен.
+
+    virtual void add_integrator(const std::string& name, int city_id, const std::string& activity) = 0;
+    // Город по имени (создаётся при необходимости) и интегратор атомарно. id или -1
+    virtual int add_integrator_with_city(const std::string& name, const std::string& city,
+                                         const std::string& activity, uint64_t* commit_token = nullptr) = 0;
+
+    virtual IntegratorRows get_integrators(uint64_t min_token = 0) = 0;
+    // До limit интеграторов с id > after_id в порядке id, с фильтром по городу/деятельности
+    virtual IntegratorPage get_integrators_page(int after_id, int limit,
+                                                const IntegratorFilter& filter = IntegratorFilter(),
+                                                uint64_t min_token = 0) = 0;
+    // Количество интеграторов под фильтром (-1 при ошибке)
+    virtual long long count_integrators(const IntegratorFilter& filter = IntegratorFilter(),
+                                        uint64_t min_token = 0) = 0;
+    virtual SearchPage search_integrators(const std::string& query, int limit, int offset,
+                                          uint64_t min_token = 0) = 0;
+
+    // Все строки в одной транзакции: при ошибке любой не вставляется ни одна
+    virtual std::vector<BatchRowResult> add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                              uint64_t* commit_token = nullptr) = 0;
+    // CSV (название,город,деятельность) одной транзакцией
+    virtual ImportStats import_integrators_csv(const CsvSource& source, bool header = false,
+                                               uint64_t* commit_token = nullptr) = 0;
+    // Все интеграторы в CSV; sink возвращает false, чтобы прервать
+    virtual bool export_integrators_csv(const CsvSink& sink) = 0;
+    // Построчная выдача без материализации всей таблицы; колбэк возвращает false,
+    // чтобы прервать. false — ошибка хранилища
+    virtual bool for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn,
+                                     uint64_t min_token = 0) = 0;
+};
+
+// Количество по столбцовому хранилищу: фильтр сравнивает коды словарей
+long long store_count(const IntegratorStore& store, const IntegratorFilter& filter);
+
+// Несколько неизменяемых столбцовых хранилищ с непересекающимися id, каждое по возрастанию id.
+// Читается как одно хранилище слиянием по id: новые строки ложатся в небольшие части,
+// и большое хранилище не пересобирается на каждую запись.
+// Строки нумеруются сквозь части в порядке parts().
+class IntegratorSet {
+public:
+    using Part = std::shared_ptr<const IntegratorStore>;
+
+    IntegratorSet() = default;
+    explicit IntegratorSet(std::vector<Part> parts);
+
+    const std::vector<Part>& parts() const { return list; }
+    size_t size() const { return total; }
+    size_t memory_bytes() const;
+
+    IntegratorRef row(size_t i) const;
+    // Сквозные номера строк в порядке id; fn возвращает false, чтобы прервать
+    void visit(const std::function<bool(uint32_t)>& fn) const;
+    // До limit номеров строк с id > after_id под фильтром, в порядке id
+    void scan(int after_id, const IntegratorFilter& filter, size_t limit, std::vector<uint32_t>& out) const;
+    long long count(const IntegratorFilter& filter) const;
+
+private:
+    std::vector<Part> list;
+    std::vector<size_t> offsets;    // сквозной номер первой строки части
+    size_t total = 0;
+};
+
+// Страница и все строки набора без копирования: строки — сквозные номера в наборе
+IntegratorPage set_page(std::shared_ptr<const IntegratorSet> set, int after_id, int limit,
+                        const IntegratorFilter& filter);
+IntegratorRows set_rows(std::shared_ptr<const IntegratorSet> set);
+// Выбранные сквозные номера строк набора
+IntegratorRows set_rows(std::shared_ptr<const IntegratorSet> set, std::vector<uint32_t> rows);
+
+// Разбор CSV (название,город,деятельность; кавычки по RFC 4180) из источника импорта.
+// false и текст в error — ошибка чтения или строка не из трёх полей
+bool parse_integrators_csv(const CsvSource& source, bool header,
+                           std::vector<NewIntegrator>& rows, std::string& error);
+// Поле CSV для экспорта: в кавычках, если содержит запятую, кавычку или перевод строки
+void append_csv_field(std::string& out, std::string_view field);
+// Экспорт CSV (id,название,город,деятельность) поверх for_each_integrator — для backend'ов
+// без собственной выгрузки вроде COPY TO STDOUT
+bool write_integrators_csv(Storage& storage, const CsvSink& sink);
@@ -0,0 +1,74 @@
+#pragma once
+#include "storage.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct WriteBehindConfig {
+    size_t max_batch = 256;     // строк в одной транзакции
+    // Строк в очереди. Через /admin_add их не больше числа потоков httplib (каждый ждёт
+    // своего коммита), так что предел срабатывает только у вызывающих submit без ожидания
+    size_t queue_limit = 10000;
+};
+
+// Итог отложенной вставки: id или текст ошибки и commit_token коммита пакета
+struct QueuedWrite {
+    int id;                 // -1 если строка не вставлена
+    std::string error;
+    uint64_t lsn;           // для чтения своих записей (0 без реплик и у SQLite/памяти)
+};
+
+// Очередь переполнена — запрос стоит отклонить (503), а не ждать
+struct WriteQueueFull : std::runtime_error {
+    WriteQueueFull() : std::runtime_error("write-behind queue is full") {}
+};
+
+// Отложенная запись с групповым коммитом: вставки из многих потоков встают в общую
+// ограниченную очередь, фоновый поток вставляет их пачками одной транзакцией через
+// add_integrators_batch. Свободный поток сразу коммитит всё, что есть в очереди
+// (до max_batch строк), а строки, пришедшие во время коммита, становятся следующей
+// пачкой — одиночная вставка не ждёт таймера, а под нагрузкой пачки растут сами.
+// Вызывающий ждёт коммита своей пачки, так что ответ по-прежнему означает «записано».
+// Если пачка откатилась, её строки повторяются по одной — чужая ошибка не роняет остальные.
+class WriteBehind {
+public:
+    WriteBehind(Storage& storage, const WriteBehindConfig& cfg = WriteBehindConfig());
+    // Дописывает всё, что уже в очереди
+    ~WriteBehind();
+
+    WriteBehind(const WriteBehind&) = delete;
+    WriteBehind& operator=(const WriteBehind&) = delete;
+
+    // Встаёт в очередь и ждёт коммита; при переполнении — WriteQueueFull
+    QueuedWrite add(NewIntegrator row);
+    std::future<QueuedWrite> submit(NewIntegrator row);
+
+    uint64_t batches() const { return batch_count; }
+    uint64_t rows() const { return row_count; }
+
+private:
+    struct Pending {
+        NewIntegrator row;
+        std::promise<QueuedWrite> done;
+    };
+
+    void run();
+    void commit(std::vector<Pending>& batch);
+
+    Storage& storage;
+    WriteBehindConfig cfg;
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Pending> queue;
+    bool stopping = false;
+
+    std::atomic<uint64_t> batch_count{0};
+    std::atomic<uint64_t> row_count{0};
+    std::thread writer;
+};
@@ -1,19 +1,65 @@
 -- Таблицы (используются IF NOT EXISTS для сохранения данных)
 CREATE_CITIES=CREATE TABLE IF NOT EXISTS cities (id SERIAL PRIMARY KEY, name TEXT UNIQUE NOT NULL);
 CREATE_INTEGRATORS=CREATE TABLE IF NOT EXISTS integrators (id SERIAL PRIMARY KEY, name TEXT, city_id INTEGER REFERENCES cities(id), activity TEXT);
+CREATE_INTEGRATORS_CITY_IDX=CREATE INDEX IF NOT EXISTS integrators_city_id_idx ON integrators(city_id, id);
+CREATE_INTEGRATORS_ACTIVITY_IDX=CREATE INDEX IF NOT EXISTS integrators_activity_idx ON integrators(activity, id);
+ALTER_INTEGRATORS_SEARCH_TSV=ALTER TABLE integrators ADD COLUMN IF NOT EXISTS search_tsv tsvector GENERATED ALWAYS AS (to_tsvector('russian', coalesce(name,'') || ' ' || coalesce(activity,''))) STORED;
+CREATE_INTEGRATORS_SEARCH_IDX=CREATE INDEX IF NOT EXISTS integrators_search_idx ON integrators USING GIN(search_tsv);
+CREATE_NOTIFY_FUNCTION=CREATE OR REPLACE FUNCTION integrators_notify() RETURNS trigger LANGUAGE plpgsql AS $$ BEGIN PERFORM pg_notify('integrators_changed', TG_TABLE_NAME); RETURN NULL; END $$;
+CREATE_CITIES_NOTIFY_TRIGGER=DROP TRIGGER IF EXISTS cities_notify ON cities;CREATE TRIGGER cities_notify AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON cities FOR EACH STATEMENT EXECUTE FUNCTION integrators_notify();
+CREATE_INTEGRATORS_NOTIFY_TRIGGER=DROP TRIGGER IF EXISTS integrators_notify ON integrators;CREATE TRIGGER integrators_notify AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON integrators FOR EACH STATEMENT EXECUTE FUNCTION integrators_notify();
+CREATE_INTEGRATORS_STAGING=CREATE UNLOGGED TABLE IF NOT EXISTS integrators_staging (name TEXT, city TEXT, activity TEXT);
 CREATE_ADMIN=CREATE TABLE IF NOT EXISTS admin (id SERIAL PRIMARY KEY, password_hash TEXT NOT NULL);
 
 -- Города
-INSERT_CITY=INSERT INTO cities(name) VALUES($1) ON CONFLICT(name) DO UPDATE SET name=EXCLUDED.name RETURNING id;
+-- DO NOTHING + чтение существующего id: для известного города не пишется новая версия строки
+INSERT_CITY=WITH ins AS (INSERT INTO cities(name) VALUES($1) ON CONFLICT(name) DO NOTHING RETURNING id) SELECT id FROM ins UNION ALL SELECT id FROM cities WHERE name=$1 LIMIT 1;
 SELECT_CITIES=SELECT id,name FROM cities ORDER BY name;
 SELECT_CITY_BY_NAME=SELECT id FROM cities WHERE name=$1;
 
 -- Интеграторы
 INSERT_INTEGRATOR=INSERT INTO integrators(name,city_id,activity) VALUES($1,$2::INTEGER,$3);
+-- Город и интегратор одним оператором (атомарно, один round trip); возвращает id интегратора и города
+ADD_INTEGRATOR_WITH_CITY=WITH ins AS (INSERT INTO cities(name) VALUES($2) ON CONFLICT(name) DO NOTHING RETURNING id), c AS (SELECT id FROM ins UNION ALL SELECT id FROM cities WHERE name=$2 LIMIT 1) INSERT INTO integrators(name,city_id,activity) SELECT $1, c.id, $3 FROM c RETURNING id, city_id;
+INSERT_INTEGRATOR_BY_CITY_NAME=INSERT INTO integrators(name,city_id,activity) VALUES($1,(SELECT id FROM cities WHERE name=$2),$3) RETURNING id;
 SELECT_INTEGRATORS=SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id;
+SELECT_INTEGRATORS_PAGE=SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id WHERE i.id > $1::INTEGER ORDER BY i.id LIMIT $2::INTEGER;
+-- Фильтры: id города берётся скалярным подзапросом, чтобы сканирование шло по (city_id, id) уже в порядке id
+SELECT_INTEGRATORS_PAGE_BY_CITY=SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id WHERE i.city_id = (SELECT id FROM cities WHERE name = $3) AND i.id > $1::INTEGER ORDER BY i.id LIMIT $2::INTEGER;
+SELECT_INTEGRATORS_PAGE_BY_ACTIVITY=SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id WHERE i.activity = $3 AND i.id > $1::INTEGER ORDER BY i.id LIMIT $2::INTEGER;
+SELECT_INTEGRATORS_PAGE_BY_CITY_ACTIVITY=SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id WHERE i.city_id = (SELECT id FROM cities WHERE name = $3) AND i.activity = $4 AND i.id > $1::INTEGER ORDER BY i.id LIMIT $2::INTEGER;
+-- Количество по фильтру; пустой параметр (NULL) — без фильтра по полю
+COUNT_INTEGRATORS=SELECT count(*) FROM integrators i LEFT JOIN cities c ON i.city_id = c.id WHERE ($1::TEXT IS NULL OR c.name = $1) AND ($2::TEXT IS NULL OR i.activity = $2);
+
+-- Полнотекстовый поиск: совпадения находит GIN-индекс, ранжируются только они
+SEARCH_INTEGRATORS=SELECT i.id, i.name, c.name, i.activity, ts_rank(i.search_tsv, q) AS rank FROM integrators i LEFT JOIN cities c ON i.city_id = c.id, websearch_to_tsquery('russian', $1) q WHERE i.search_tsv @@ q ORDER BY rank DESC, i.id LIMIT $2::INTEGER OFFSET $3::INTEGER;
+
+-- Импорт CSV через промежуточную таблицу
+IMPORT_TRUNCATE_STAGING=TRUNCATE integrators_staging;
+COPY_STAGING_CSV=COPY integrators_staging(name,city,activity) FROM STDIN (FORMAT csv);
+COPY_STAGING_CSV_HEADER=COPY integrators_staging(name,city,activity) FROM STDIN (FORMAT csv, HEADER true);
+IMPORT_MERGE_CITIES=INSERT INTO cities(name) SELECT DISTINCT city FROM integrators_staging WHERE city IS NOT NULL ON CONFLICT(name) DO NOTHING;
+IMPORT_MERGE_INTEGRATORS=INSERT INTO integrators(name,city_id,activity) SELECT s.name, c.id, s.activity FROM integrators_staging s LEFT JOIN cities c ON c.name = s.city;
+
+-- Экспорт CSV: столбцы как у SELECT_INTEGRATORS
+COPY_INTEGRATORS_CSV=COPY (SELECT i.id, i.name, c.name, i.activity FROM integrators i LEFT JOIN cities c ON i.city_id = c.id) TO STDOUT (FORMAT csv);
+
+-- Управление транзакциями (простой протокол, без подготовки) — ради статистики по ключам
+TX_BEGIN=BEGIN;
+TX_BEGIN_SNAPSHOT=BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY;
+TX_COMMIT=COMMIT;
+TX_ROLLBACK=ROLLBACK;
 
 -- Админ
 INSERT_ADMIN=INSERT INTO admin(password_hash) VALUES($1);
 DELETE_ADMIN=DELETE FROM admin;
 SELECT_ADMIN_COUNT=SELECT 1 FROM admin LIMIT 1;
-SELECT_ADMIN_BY_PASSWORD=SELECT 1 FROM admin WHERE password_hash=$1;
\ No newline at end of file
+SELECT_ADMIN_HASH=SELECT password_hash FROM admin LIMIT 1;
+UPDATE_ADMIN_HASH=UPDATE admin SET password_hash=$1 WHERE password_hash=$2;
+
+-- Бенчмарк декодирования (строки той же формы, что SELECT_INTEGRATORS)
+BENCH_INTEGRATORS=SELECT g, 'Интегратор ' || g, 'Город ' || (g % 300), md5(g::text) FROM generate_series(1, $1::INTEGER) g;
+
+-- Реплики для чтения: позиция WAL primary, применённая позиция и отставание реплики
+PRIMARY_WAL_LSN=SELECT pg_current_wal_lsn();
+REPLICA_STATUS=SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_replay_lsn() ELSE pg_current_wal_lsn() END, COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000, 0);
@@ -0,0 +1,325 @@
+#include "async_db.h"
+#include "pg_decode.h"
+#include <stdexcept>
+#include <iostream>
+#include <type_traits>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+// Ожидание готовности сокетов: epoll на Linux, poll в остальных системах
+class AsyncDatabase::Poller {
+public:
+    struct Event {
+        int fd;
+        bool in;
+        bool out;
+    };
+
+#ifdef __linux__
+    Poller() {
+        ep = epoll_create1(EPOLL_CLOEXEC);
+        if (ep < 0) throw std::runtime_error("epoll_create1 failed");
+    }
+    ~Poller() { close(ep); }
+
+    void add(int fd) { ctl(EPOLL_CTL_ADD, fd, EPOLLIN); }
+    void set_write(int fd, bool on) { ctl(EPOLL_CTL_MOD, fd, on ? EPOLLIN | EPOLLOUT : EPOLLIN); }
+    void remove(int fd) { epoll_ctl(ep, EPOLL_CTL_DEL, fd, NULL); }
+
+    std::vector<Event> wait(int timeout_ms) {
+        epoll_event evs[64];
+        int n = epoll_wait(ep, evs, 64, timeout_ms);
+        std::vector<Event> out;
+        for (int i = 0; i < n; i++) {
+            // Ошибку и обрыв обрабатываем как чтение: PQconsumeInput вернёт ошибку
+            bool in = evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP);
+            out.push_back({evs[i].data.fd, in, bool(evs[i].events & EPOLLOUT)});
+        }
+        return out;
+    }
+
+private:
+    void ctl(int op, int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(ep, op, fd, &ev);
+    }
+
+    int ep;
+#else
+    void add(int fd) { fds.push_back({fd, POLLIN, 0}); }
+    void set_write(int fd, bool on) {
+        for (auto& p : fds)
+            if (p.fd == fd) p.events = POLLIN | (on ? POLLOUT : 0);
+    }
+    void remove(int fd) {
+        for (size_t i = 0; i < fds.size(); i++)
+            if (fds[i].fd == fd) { fds.erase(fds.begin() + i); break; }
+    }
+
+    std::vector<Event> wait(int timeout_ms) {
+        std::vector<Event> out;
+        if (poll(fds.data(), fds.size(), timeout_ms) <= 0) return out;
+        for (auto& p : fds) {
+            if (!p.revents) continue;
+            bool in = p.revents & (POLLIN | POLLERR | POLLHUP);
+            out.push_back({p.fd, in, bool(p.revents & POLLOUT)});
+        }
+        return out;
+    }
+
+private:
+    std::vector<pollfd> fds;
+#endif
+};
+
+AsyncDatabase::AsyncDatabase(const std::string& conninfo, size_t connections)
+    : poller(new Poller()) {
+    if (pipe(wake_fd) != 0) throw std::runtime_error("pipe failed");
+    for (int fd : wake_fd) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    poller->add(wake_fd[0]);
+
+    conns.resize(connections ? connections : 1);
+    for (auto& c : conns) {
+        c.conn = PQconnectdb(conninfo.c_str());
+        if (PQstatus(c.conn) != CONNECTION_OK) {
+            std::string error = PQerrorMessage(c.conn);
+            for (auto& x : conns) PQfinish(x.conn);
+            close(wake_fd[0]);
+            close(wake_fd[1]);
+            throw std::runtime_error(error);
+        }
+        PQsetnonblocking(c.conn, 1);
+        c.fd = PQsocket(c.conn);
+        poller->add(c.fd);
+    }
+
+    reactor = std::thread([this]() { run(); });
+}
+
+AsyncDatabase::~AsyncDatabase() {
+    {
+        // Под m: после этого submit уже ничего не добавит в очередь
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    char b = 0;
+    if (write(wake_fd[1], &b, 1) < 0) {}
+    reactor.join();
+
+    // Реактор остановлен: оставшиеся в очереди запросы получают ошибку
+    std::deque<std::unique_ptr<Op>> left;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        left.swap(queue);
+    }
+    for (auto& op : left) {
+        pending--;
+        op->done(NULL, "AsyncDatabase остановлена");
+    }
+
+    for (auto& c : conns) {
+        PQclear(c.last);
+        PQfinish(c.conn);
+    }
+    close(wake_fd[0]);
+    close(wake_fd[1]);
+}
+
+void AsyncDatabase::submit(std::unique_ptr<Op> op) {
+    {
+        // Проверка и вставка под одним мьютексом с остановкой в деструкторе:
+        // принятый запрос либо выполнит реактор, либо завершит деструктор
+        std::unique_lock<std::mutex> lk(m);
+        if (stopping) {
+            lk.unlock();
+            op->done(NULL, "AsyncDatabase остановлена");
+            return;
+        }
+        pending++;
+        queue.push_back(std::move(op));
+    }
+    char b = 0;
+    if (write(wake_fd[1], &b, 1) < 0) {}  // pipe полон — реактор и так проснётся
+}
+
+void AsyncDatabase::run() {
+    while (!stopping) {
+        for (auto& ev : poller->wait(1000)) {
+            if (ev.fd == wake_fd[0]) {
+                char buf[256];
+                while (read(wake_fd[0], buf, sizeof(buf)) > 0) {}
+                continue;
+            }
+            for (auto& c : conns) {
+                if (c.fd != ev.fd) continue;
+                if (ev.out) on_writable(c);
+                if (ev.in) on_readable(c);
+                break;
+            }
+        }
+        dispatch();
+    }
+
+    // Остановка: запросы на соединениях получают ошибку, очередь завершает деструктор
+    for (auto& c : conns)
+        if (c.op) finish(c, "AsyncDatabase остановлена");
+}
+
+// Раздача запросов из очереди свободным соединениям
+void AsyncDatabase::dispatch() {
+    for (auto& c : conns) {
+        if (c.op) continue;
+        std::unique_ptr<Op> op;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (queue.empty()) return;
+            op = std::move(queue.front());
+            queue.pop_front();
+        }
+        start(c, std::move(op));
+    }
+}
+
+void AsyncDatabase::start(Conn& c, std::unique_ptr<Op> op) {
+    c.op = std::move(op);
+    std::vector<const char*> values;
+    for (auto& p : c.op->params) values.push_back(p.c_str());
+
+    if (!PQsendQueryParams(c.conn, SqlLoader::get(c.op->key), int(values.size()), NULL,
+                           values.data(), NULL, NULL, c.op->result_format)) {
+        finish(c, PQerrorMessage(c.conn));
+        if (PQstatus(c.conn) != CONNECTION_OK) reconnect(c);
+        return;
+    }
+    on_writable(c);
+}
+
+void AsyncDatabase::on_writable(Conn& c) {
+    int f = PQflush(c.conn);
+    if (f < 0) {
+        if (c.op) finish(c, PQerrorMessage(c.conn));
+        reconnect(c);
+        return;
+    }
+    bool more = f == 1;  // запрос не влез в буфер сокета — ждём EPOLLOUT
+    if (more != c.want_write) {
+        c.want_write = more;
+        poller->set_write(c.fd, more);
+    }
+}
+
+void AsyncDatabase::on_readable(Conn& c) {
+    if (!PQconsumeInput(c.conn)) {
+        if (c.op) finish(c, PQerrorMessage(c.conn));
+        reconnect(c);
+        return;
+    }
+    if (!c.op) return;
+
+    // Результаты забираем, только пока libpq не ждёт новых данных
+    while (!PQisBusy(c.conn)) {
+        PGresult* r = PQgetResult(c.conn);
+        if (!r) {
+            finish(c, "");
+            return;
+        }
+        PQclear(c.last);
+        c.last = r;
+    }
+}
+
+void AsyncDatabase::finish(Conn& c, const std::string& error) {
+    std::unique_ptr<Op> op = std::move(c.op);
+    PGresult* r = c.last;
+    c.last = nullptr;
+    if (!error.empty()) {
+        PQclear(r);
+        r = nullptr;
+    }
+    pending--;
+    op->done(r, error);
+}
+
+// Восстановление оборванного соединения (блокирует реактор на время PQreset)
+void AsyncDatabase::reconnect(Conn& c) {
+    poller->remove(c.fd);
+    PQreset(c.conn);
+    PQsetnonblocking(c.conn, 1);
+    c.fd = PQsocket(c.conn);
+    c.want_write = false;
+    if (c.fd >= 0) poller->add(c.fd);
+    if (PQstatus(c.conn) != CONNECTION_OK)
+        std::cerr << "Async reconnect error: " << PQerrorMessage(c.conn) << std::endl;
+}
+
+// Запрос с обработкой результата: decode превращает PGresult в значение future,
+// ошибка соединения или запроса становится исключением
+template <class T, class Decode>
+static std::function<void(PGresult*, const std::string&)>
+completion(std::shared_ptr<std::promise<T>> promise, Decode decode) {
+    return [promise, decode](PGresult* r, const std::string& error) {
+        ExecStatusType st = r ? PQresultStatus(r) : PGRES_FATAL_ERROR;
+        if (st != PGRES_TUPLES_OK && st != PGRES_COMMAND_OK) {
+            std::string msg = !error.empty() ? error : r ? PQresultErrorMessage(r) : "нет результата";
+            PQclear(r);
+            promise->set_exception(std::make_exception_ptr(std::runtime_error(msg)));
+            return;
+        }
+        if constexpr (std::is_void<T>::value) {
+            promise->set_value();
+        } else {
+            promise->set_value(decode(r));
+        }
+        PQclear(r);
+    };
+}
+
+static int first_int(const PGresult* r) {
+    return PQntuples(r) > 0 ? int(pg_int(r, 0, 0)) : -1;
+}
+
+std::future<std::vector<Integrator>> AsyncDatabase::get_integrators() {
+    auto p = std::make_shared<std::promise<std::vector<Integrator>>>();
+    auto f = p->get_future();
+    submit(std::unique_ptr<Op>(new Op{Query::SELECT_INTEGRATORS, {}, 1, completion(p, decode_integrators)}));
+    return f;
+}
+
+std::future<std::vector<City>> AsyncDatabase::get_cities() {
+    auto p = std::make_shared<std::promise<std::vector<City>>>();
+    auto f = p->get_future();
+    submit(std::unique_ptr<Op>(new Op{Query::SELECT_CITIES, {}, 1, completion(p, decode_cities)}));
+    return f;
+}
+
+std::future<int> AsyncDatabase::add_city(const std::string& name) {
+    auto p = std::make_shared<std::promise<int>>();
+    auto f = p->get_future();
+    submit(std::unique_ptr<Op>(new Op{Query::INSERT_CITY, {name}, 1, completion(p, first_int)}));
+    return f;
+}
+
+std::future<int> AsyncDatabase::get_city_id(const std::string& name) {
+    auto p = std::make_shared<std::promise<int>>();
+    auto f = p->get_future();
+    submit(std::unique_ptr<Op>(new Op{Query::SELECT_CITY_BY_NAME, {name}, 1, completion(p, first_int)}));
+    return f;
+}
+
+std::future<void> AsyncDatabase::add_integrator(const std::string& name,
+                                                int city_id,
+                                                const std::string& activity) {
+    auto p = std::make_shared<std::promise<void>>();
+    auto f = p->get_future();
+    submit(std::unique_ptr<Op>(new Op{Query::INSERT_INTEGRATOR,
+        {name, std::to_string(city_id), activity}, 0, completion(p, nullptr)}));
+    return f;
+}
@@ -1,8 +1,13 @@
 #include "console.h"
+#include "db.h"
+#include "async_db.h"
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
 
-void print_table(const std::vector<Integrator>& v) {
-    for (auto& i : v) {
+void print_table(const IntegratorRows& v) {
+    for (IntegratorRef i : v) {
         std::cout << i.id << " | "
                   << i.name << " | "
                   << i.city << " | "
@@ -10,10 +15,57 @@ void print_table(const std::vector<Integrator>& v) {
     }
 }
 
-void console_loop(Database& db) {
+void print_pool_stats(const PoolStats& s) {
+    std::cout << "Соединений: " << s.size << " / " << s.max_size
+              << " (занято " << s.in_use << ", пик " << s.peak_in_use << ")\n"
+              << "Выдач: " << s.checkouts << ", с ожиданием: " << s.waits
+              << ", таймаутов: " << s.timeouts << ", reset: " << s.resets << "\n"
+              << std::fixed << std::setprecision(3)
+              << "Ожидание: среднее "
+              << (s.waits ? s.wait_ns_total / 1e6 / s.waits : 0.0) << " мс, макс "
+              << s.wait_ns_max / 1e6 << " мс\n"
+              << "Загрузка пула: " << s.utilization() * 100 << "%\n";
+}
+
+// Проверка пароля; при переполненной очереди хеширования — отказ, а не исключение
+static bool admin_ok(Storage& db, const std::string& pwd) {
+    try {
+        return db.check_admin_password(pwd);
+    } catch (const HashQueueFull&) {
+        std::cout << "Сервер занят проверкой паролей, повторите позже\n";
+        return false;
+    }
+}
+
+void print_query_stats(const std::vector<QueryStatsRow>& v) {
+    std::cout << std::left << std::setw(42) << "Ключ" << std::right
+              << std::setw(9) << "вызовов" << std::setw(7) << "ошибок"
+              << std::setw(10) << "строк" << std::setw(12) << "байт"
+              << std::setw(9) << "ср.мс" << std::setw(9) << "p50" << std::setw(9) << "p95"
+              << std::setw(9) << "p99" << std::setw(9) << "макс" << "\n";
+    for (auto& q : v) {
+        std::cout << std::left << std::setw(42) << SqlLoader::name(q.key) << std::right
+                  << std::setw(9) << q.count << std::setw(7) << q.errors
+                  << std::setw(10) << q.rows << std::setw(12) << q.bytes
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(9) << q.mean_ms << std::setw(9) << q.p50_ms << std::setw(9) << q.p95_ms
+                  << std::setw(9) << q.p99_ms << std::setw(9) << q.max_ms << "\n";
+    }
+}
+
+void console_loop(Storage& db, Database* pg) {
     while (true) {
         std::cout << "\n1. Показать интеграторов\n"
                   << "2. Добавить интегратора (admin)\n"
+                  << "3. Статистика пула соединений и реплик\n"
+                  << "4. Бенчмарк декодирования (text/binary)\n"
+                  << "5. Пакетная загрузка из TSV-файла (admin)\n"
+                  << "6. Импорт CSV через COPY (admin)\n"
+                  << "7. Экспорт в CSV\n"
+                  << "8. Асинхронные запросы: N списков одновременно\n"
+                  << "9. Проверка индексных планов фильтров\n"
+                  << "10. Бенчмарк хеширования пароля (PBKDF2)\n"
+                  << "11. Статистика запросов по ключам queries.sql\n"
                   << "0. Выход\n> ";
 
         int c;
@@ -30,7 +82,7 @@ void console_loop(Database& db) {
             std::cout << "Пароль: ";
             std::cin >> pwd;
 
-            if (!db.check_admin_password(pwd)) {
+            if (!admin_ok(db, pwd)) {
                 std::cout << "Неверно\n";
                 continue;
             }
@@ -40,14 +92,204 @@ void console_loop(Database& db) {
             std::cout << "Город: "; std::cin >> cit;
             std::cout << "Деятельность: "; std::cin >> a;
 
-            int city_id = db.add_city(cit);
-            if (city_id < 0) {
-                std::cout << "Ошибка добавления города\n";
+            if (db.add_integrator_with_city(n, cit, a) < 0) {
+                std::cout << "Ошибка добавления\n";
                 continue;
             }
-
-            db.add_integrator(n, city_id, a);
             std::cout << "Интегратор добавлен\n";
         }
+
+        if (c == 3 && !pg) {
+            std::cout << "Доступно только с PostgreSQL\n";
+            continue;
+        }
+
+        if (c == 3) {
+            print_pool_stats(pg->pool_stats());
+            SnapshotStats snap = pg->snapshot_stats();
+            if (snap.enabled) {
+                std::cout << "Снимок в памяти: " << snap.rows << " строк, городов " << snap.cities
+                          << ", видов деятельности " << snap.activities << ", "
+                          << snap.bytes / 1024 << " КБ\n";
+            }
+            for (auto& r : pg->replica_status()) {
+                std::cout << "Реплика " << r.conninfo << ": " << (r.healthy ? "в работе" : "отключена")
+                          << ", отставание " << std::fixed << std::setprecision(0) << r.lag_ms
+                          << " мс / " << r.lag_bytes << " байт WAL\n";
+            }
+        }
+
+        if (c == 4 && !pg) {
+            std::cout << "Доступно только с PostgreSQL\n";
+            continue;
+        }
+
+        if (c == 4) {
+            int rows;
+            std::cout << "Строк (например 100000): ";
+            std::cin >> rows;
+            auto b = pg->benchmark_decode(rows);
+            std::cout << std::fixed << std::setprecision(2)
+                      << "Строк: " << b.rows << "\n"
+                      << "text:   получение " << b.text_fetch_ms << " мс, декодирование "
+                      << b.text_decode_ms << " мс\n"
+                      << "binary: получение " << b.binary_fetch_ms << " мс, декодирование "
+                      << b.binary_decode_ms << " мс\n";
+        }
+
+        if (c == 5) {
+            std::string pwd, path;
+            std::cout << "Пароль: ";
+            std::cin >> pwd;
+            if (!admin_ok(db, pwd)) {
+                std::cout << "Неверно\n";
+                continue;
+            }
+            std::cout << "Файл (название<TAB>город<TAB>деятельность): ";
+            std::cin >> path;
+            std::ifstream file(path);
+            if (!file) {
+                std::cout << "Файл не найден\n";
+                continue;
+            }
+
+            auto rows = parse_integrators_tsv(file);
+            auto t0 = std::chrono::steady_clock::now();
+            auto results = db.add_integrators_batch(rows);
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+            size_t added = 0, shown = 0;
+            for (size_t i = 0; i < results.size(); i++) {
+                if (results[i].id >= 0) added++;
+                else if (shown++ < 10) std::cout << "Строка " << i + 1 << ": " << results[i].error << "\n";
+            }
+            std::cout << "Добавлено " << added << " из " << rows.size()
+                      << " за " << std::fixed << std::setprecision(3) << sec << " с\n";
+        }
+
+        if (c == 6) {
+            std::string pwd, path, header;
+            std::cout << "Пароль: ";
+            std::cin >> pwd;
+            if (!admin_ok(db, pwd)) {
+                std::cout << "Неверно\n";
+                continue;
+            }
+            std::cout << "CSV-файл (название,город,деятельность): ";
+            std::cin >> path;
+            std::cout << "Первая строка — заголовок? (y/n): ";
+            std::cin >> header;
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::cout << "Файл не найден\n";
+                continue;
+            }
+
+            auto st = db.import_integrators_csv([&file](const CsvSink& sink) {
+                char buf[64 * 1024];
+                while (file.read(buf, sizeof(buf)) || file.gcount() > 0) {
+                    if (!sink(buf, file.gcount())) return false;
+                }
+                return true;
+            }, header == "y");
+
+            if (!st.ok) {
+                std::cout << "Ошибка импорта: " << st.error << "\n";
+                continue;
+            }
+            std::cout << "Импортировано " << st.rows << " строк за " << std::fixed
+                      << std::setprecision(3) << st.seconds << " с ("
+                      << std::setprecision(0) << st.rows_per_sec() << " строк/с)\n";
+        }
+
+        if (c == 7) {
+            std::string path;
+            std::cout << "Файл для выгрузки: ";
+            std::cin >> path;
+            std::ofstream file(path, std::ios::binary);
+            if (!file) {
+                std::cout << "Не удалось открыть файл\n";
+                continue;
+            }
+
+            size_t bytes = 0;
+            bool ok = db.export_integrators_csv([&](const char* data, size_t len) {
+                bytes += len;
+                return bool(file.write(data, len));
+            });
+            if (ok) std::cout << "Выгружено " << bytes << " байт\n";
+            else std::cout << "Ошибка экспорта\n";
+        }
+
+        if (c == 8 && !pg) {
+            std::cout << "Доступно только с PostgreSQL\n";
+            continue;
+        }
+
+        if (c == 8) {
+            int n;
+            std::cout << "Запросов: ";
+            std::cin >> n;
+
+            auto t0 = std::chrono::steady_clock::now();
+            std::vector<std::future<std::vector<Integrator>>> futures;
+            for (int i = 0; i < n; i++) futures.push_back(pg->async().get_integrators());
+            std::cout << "В полёте: " << pg->async().in_flight() << "\n";
+
+            size_t rows = 0, errors = 0;
+            for (auto& f : futures) {
+                try {
+                    rows += f.get().size();
+                } catch (const std::exception& e) {
+                    if (errors++ == 0) std::cout << "Ошибка: " << e.what() << "\n";
+                }
+            }
+            double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            std::cout << "Выполнено " << n - errors << " запросов (" << rows << " строк) за "
+                      << std::fixed << std::setprecision(3) << sec << " с\n";
+        }
+
+        if (c == 9 && !pg) {
+            std::cout << "Доступно только с PostgreSQL\n";
+            continue;
+        }
+
+        if (c == 9) {
+            int rows;
+            std::cout << "Наибольшее число синтетических строк (например 1000000): ";
+            std::cin >> rows;
+            // Таблица растёт в 100 раз: 1%, 10% и 100% от введённого
+            std::vector<int> sizes;
+            for (int s : {rows / 100, rows / 10, rows})
+                if (s > 0) sizes.push_back(s);
+            auto checks = pg->check_filter_plans(sizes);
+            bool all_ok = !checks.empty();
+            for (auto& pc : checks) {
+                std::cout << (pc.index_scan ? "[OK]   " : "[FAIL] ") << SqlLoader::name(pc.key)
+                          << ", строк: " << pc.rows << "\n";
+                if (!pc.index_scan) std::cout << pc.plan;
+                all_ok = all_ok && pc.index_scan;
+            }
+            std::cout << (all_ok ? "Все фильтры используют индексы на всех размерах\n"
+                                 : "ОШИБКА: есть планы без индекса фильтра\n");
+        }
+
+        if (c == 10) {
+            // Ориентир: одна проверка пароля должна занимать десятки миллисекунд
+            for (auto& b : benchmark_kdf({10000, 50000, 100000, 200000, 400000, 800000})) {
+                std::cout << std::setw(8) << b.iterations << " итераций: "
+                          << std::fixed << std::setprecision(1) << b.hashes_per_sec << " хешей/с, "
+                          << b.ms_per_hash << " мс на хеш\n";
+            }
+        }
+
+        if (c == 11 && !pg) {
+            std::cout << "Доступно только с PostgreSQL\n";
+            continue;
+        }
+
+        if (c == 11) {
+            print_query_stats(pg->query_stats());
+        }
     }
 }
@@ -1,75 +1,346 @@
 #include "db.h"
+#include "async_db.h"
+#include "replica.h"
+#include "pg_decode.h"
 #include <stdexcept>
-#include <openssl/sha.h>
-#include <sstream>
-#include <iomanip>
+#include <chrono>
+#include <future>
+#include <cstdlib>
 #include <iostream>
+#include <set>
+#include <algorithm>
 
-std::map<std::string, std::string> SqlLoader::queries;
+// Задержки, строки, байты и ошибки по ключам queries.sql (Database::query_stats)
+static QueryStats key_stats;
+// Журнал медленных запросов (Database::enable_slow_log), nullptr — выключен
+static std::atomic<SlowQueryLog*> slow_log{nullptr};
+using Clock = std::chrono::steady_clock;
 
-int Database::add_city(const std::string& name) {
-    const char* values[] = {name.c_str()};
-    PGresult* r = PQexecParams(conn, SqlLoader::get("INSERT_CITY").c_str(),
-        1, NULL, values, NULL, NULL, 0);
-    
-    int city_id = -1;
-    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) {
-        city_id = std::stoi(PQgetvalue(r, 0, 0));
-    } else {
-        std::cerr << "Insert city error: " << PQerrorMessage(conn) << std::endl;
+// После перезагрузки queries.sql подготовленные на соединении запросы устарели:
+// снимаем их все, дальше они готовятся заново по мере использования.
+// Если DEALLOCATE не прошёл (например, транзакция в ошибке) — повторим при следующем вызове.
+static void sync_queries(PgConn& c) {
+    uint64_t v = SqlLoader::version();
+    if (c.sql_version == v) return;
+    if (c.prepared.any()) {
+        PGresult* r = PQexec(c.conn, "DEALLOCATE ALL");
+        bool ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+        PQclear(r);
+        if (!ok) return;
+        c.prepared.reset();
     }
-    PQclear(r);
-    return city_id;
+    c.sql_version = v;
 }
 
-std::vector<City> Database::get_cities() {
-    PGresult* r = PQexec(conn, SqlLoader::get("SELECT_CITIES").c_str());
-    std::vector<City> v;
-    
+// Подготовка всех запросов из queries.sql на соединении одним пакетом (pipeline).
+// Ошибки не критичны: неподготовленный запрос будет подготовлен при первом вызове.
+static void prepare_all(PgConn& c) {
+    sync_queries(c);
+    std::vector<Query> keys;
+    if (!PQenterPipelineMode(c.conn)) return;
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        Query q = Query(i);
+        if (!SqlLoader::preparable(q) || c.prepared[i]) continue;
+        if (!PQsendPrepare(c.conn, SqlLoader::name(q), SqlLoader::get(q), 0, NULL)) break;
+        keys.push_back(q);
+    }
+    PQpipelineSync(c.conn);
+
+    // Результаты каждой команды завершаются NULL, весь пакет — PGRES_PIPELINE_SYNC
+    size_t i = 0;
+    while (i <= keys.size()) {
+        PGresult* r = PQgetResult(c.conn);
+        if (!r) { i++; continue; }
+        ExecStatusType st = PQresultStatus(r);
+        PQclear(r);
+        if (st == PGRES_PIPELINE_SYNC) break;
+        if (st == PGRES_COMMAND_OK && i < keys.size()) c.prepared.set(size_t(keys[i]));
+    }
+    PQexitPipelineMode(c.conn);
+}
+
+// Подготовка запроса на соединении, если он ещё не подготовлен.
+// При ошибке возвращает результат PQprepare (его нужно очистить), иначе NULL.
+static PGresult* prepare(PgConn& c, Query key) {
+    sync_queries(c);
+    if (c.prepared[size_t(key)]) return NULL;
+    PGresult* p = PQprepare(c.conn, SqlLoader::name(key), SqlLoader::get(key), 0, NULL);
+    if (PQresultStatus(p) != PGRES_COMMAND_OK) return p;
+    PQclear(p);
+    c.prepared.set(size_t(key));
+    return NULL;
+}
+
+// Команда из queries.sql простым протоколом (управление транзакцией): без подготовки,
+// но со статистикой по ключу
+static PGresult* exec_simple(PGconn* conn, Query key) {
+    auto t0 = Clock::now();
+    PGresult* r = PQexec(conn, SqlLoader::get(key));
+    key_stats.record(key, Clock::now() - t0, r);
+    return r;
+}
+
+// Выполнение запроса из queries.sql как подготовленного (PQprepare один раз на соединение).
+// Ошибка подготовки возвращается как результат, чтобы вызывающий обработал её как обычно.
+static PGresult* exec(PooledConn& conn, Query key,
+                      int n_params = 0, const char* const* values = NULL,
+                      int result_format = 0, bool retry = true) {
+    PgConn& c = conn.entry();
+    auto t0 = Clock::now();
+    if (PGresult* p = prepare(c, key)) {
+        key_stats.record(key, Clock::now() - t0, p);
+        return p;
+    }
+
+    PGresult* r = PQexecPrepared(c.conn, SqlLoader::name(key), n_params, values, NULL, NULL, result_format);
+
+    // Запрос мог пропасть на сервере (DISCARD ALL, пулер) — готовим заново один раз
+    const char* state = PQresultErrorField(r, PG_DIAG_SQLSTATE);
+    if (retry && state && std::string(state) == "26000") {
+        PQclear(r);
+        c.prepared.reset(size_t(key));
+        return exec(conn, key, n_params, values, result_format, false);
+    }
+    auto took = Clock::now() - t0;
+    key_stats.record(key, took, r);
+    SlowQueryLog* log = slow_log.load(std::memory_order_acquire);
+    if (log && took >= log->threshold()) {
+        long long rows = PQresultStatus(r) == PGRES_TUPLES_OK ? PQntuples(r) : std::atoll(PQcmdTuples(r));
+        log->submit(key, n_params, values, took, rows);
+    }
+    return r;
+}
+
+// Строки SELECT_INTEGRATORS (id, name, city, activity) в текстовом формате
+static std::vector<Integrator> decode_integrators_text(const PGresult* r) {
+    std::vector<Integrator> v;
     for (int i = 0; i < PQntuples(r); i++) {
         v.push_back({
             std::stoi(PQgetvalue(r,i,0)),
-            PQgetvalue(r,i,1)
+            PQgetvalue(r,i,1),
+            PQgetvalue(r,i,2),
+            PQgetvalue(r,i,3)
         });
     }
+    return v;
+}
+
+// То же в бинарном формате: без разбора чисел и поиска конца строк
+std::vector<Integrator> decode_integrators(const PGresult* r) {
+    int n = PQntuples(r);
+    std::vector<Integrator> v;
+    v.reserve(n);
+    for (int i = 0; i < n; i++) {
+        v.push_back({
+            int(pg_int(r,i,0)),
+            std::string(pg_text(r,i,1)),
+            std::string(pg_text(r,i,2)),
+            std::string(pg_text(r,i,3))
+        });
+    }
+    return v;
+}
+
+static IntegratorRef pg_integrator_row(const void* owner, size_t i) {
+    auto r = static_cast<const PGresult*>(owner);
+    int row = int(i);
+    return {int(pg_int(r, row, 0)), pg_text(r, row, 1), pg_text(r, row, 2), pg_text(r, row, 3)};
+}
+
+IntegratorRows pg_integrator_rows(PGresult* r) {
+    size_t n = PQresultStatus(r) == PGRES_TUPLES_OK ? size_t(PQntuples(r)) : 0;
+    return IntegratorRows(std::shared_ptr<const PGresult>(r, PQclear), pg_integrator_row, n);
+}
+
+std::vector<City> decode_cities(const PGresult* r) {
+    std::vector<City> v;
+    v.reserve(PQntuples(r));
+    for (int i = 0; i < PQntuples(r); i++) {
+        v.push_back({
+            int(pg_int(r,i,0)),
+            std::string(pg_text(r,i,1))
+        });
+    }
+    return v;
+}
+
+int Database::add_city(const std::string& name) {
+    // Существующий город не требует обращения к БД
+    int city_id = city_cache.find(name);
+    if (city_id >= 0) return city_id;
+
+    {
+        PooledConn conn = pool.acquire();
+        const char* values[] = {name.c_str()};
+        PGresult* r = exec(conn, Query::INSERT_CITY, 1, values, 1);
+        
+        if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) {
+            city_id = int(pg_int(r, 0, 0));
+        } else if (PQresultStatus(r) == PGRES_TUPLES_OK) {
+            // Город вставлен параллельной транзакцией после начала нашего оператора
+            PQclear(r);
+            r = exec(conn, Query::SELECT_CITY_BY_NAME, 1, values, 1);
+            if (PQntuples(r) > 0) city_id = int(pg_int(r, 0, 0));
+        } else {
+            std::cerr << "Insert city error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    if (city_id < 0) return -1;
+    city_cache.put(name, city_id);
+    after_write({}, {{city_id, name}});
+    return city_id;
+}
+
+std::vector<City> Database::get_cities() {
+    if (auto s = snapshot()) return s->cities;
+
+    PooledConn conn = read_conn(0);
+    PGresult* r = exec(conn, Query::SELECT_CITIES, 0, NULL, 1);
+    std::vector<City> v = decode_cities(r);
     PQclear(r);
     return v;
 }
 
 int Database::get_city_id(const std::string& name) {
+    int city_id = city_cache.find(name);
+    if (city_id >= 0) return city_id;
+
+    PooledConn conn = pool.acquire();
     const char* values[] = {name.c_str()};
-    PGresult* r = PQexecParams(conn,
-        SqlLoader::get("SELECT_CITY_BY_NAME").c_str(),
-        1, NULL, values, NULL, NULL, 0);
+    PGresult* r = exec(conn, Query::SELECT_CITY_BY_NAME, 1, values, 1);
     
-    int city_id = -1;
     if (PQntuples(r) > 0) {
-        city_id = std::stoi(PQgetvalue(r, 0, 0));
+        city_id = int(pg_int(r, 0, 0));
+        city_cache.put(name, city_id);
     }
     PQclear(r);
     return city_id;
 }
 
-static std::string sha256(const std::string& str) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char*)str.c_str(), str.size(), hash);
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    return ss.str();
+Database::Database(const std::string& conninfo, const PoolConfig& pool_cfg,
+                   const KdfConfig& kdf_cfg, const ReplicaConfig& replica_cfg)
+    : conninfo(conninfo), pool_cfg(pool_cfg), pool(conninfo, pool_cfg),
+      kdf_cfg(kdf_cfg), hashers(kdf_cfg.threads, kdf_cfg.queue_limit), replica_cfg(replica_cfg) {}
+
+Database::~Database() {
+    if (slow) slow_log.store(nullptr, std::memory_order_release);
 }
 
-Database::Database(const std::string& conninfo) {
-    conn = PQconnectdb(conninfo.c_str());
-    if (PQstatus(conn) != CONNECTION_OK)
-        throw std::runtime_error(PQerrorMessage(conn));
+void Database::enable_slow_log(const SlowLogConfig& cfg) {
+    if (slow) return;
+    slow.reset(new SlowQueryLog(conninfo, cfg));
+    slow_log.store(slow.get(), std::memory_order_release);
 }
 
-Database::~Database() {
-    PQfinish(conn);
+void Database::enable_replica() {
+    if (!replica) replica.reset(new Replica(conninfo, [this]() { return load_snapshot(); }));
+}
+
+std::shared_ptr<const Snapshot> Database::snapshot() const {
+    return replica ? replica->current() : nullptr;
+}
+
+// Согласованное чтение обеих таблиц в одной транзакции REPEATABLE READ
+std::shared_ptr<const Snapshot> Database::load_snapshot() {
+    PooledConn conn = pool.acquire();
+    PGresult* r = exec_simple(conn, Query::TX_BEGIN_SNAPSHOT);
+    PQclear(r);
+
+    auto s = std::make_shared<Snapshot>();
+    r = exec(conn, Query::SELECT_CITIES, 0, NULL, 1);
+    bool ok = PQresultStatus(r) == PGRES_TUPLES_OK;
+    if (ok) s->cities = decode_cities(r);
+    PQclear(r);
+
+    r = exec(conn, Query::SELECT_INTEGRATORS, 0, NULL, 1);
+    ok = ok && PQresultStatus(r) == PGRES_TUPLES_OK;
+    if (ok) {
+        // Поля копируются прямо из PGresult в столбцы, без промежуточных Integrator
+        int n = PQntuples(r);
+        size_t name_bytes = 0;
+        for (int i = 0; i < n; i++) name_bytes += PQgetlength(r, i, 1);
+        auto store = std::make_shared<IntegratorStore>();
+        store->reserve(n, name_bytes);
+        for (int i = 0; i < n; i++)
+            store->add(int(pg_int(r, i, 0)), pg_text(r, i, 1), pg_text(r, i, 2), pg_text(r, i, 3));
+        store->finish();
+        s->integrators = IntegratorSet({std::move(store)});
+    } else {
+        std::cerr << "Snapshot load error: " << PQerrorMessage(conn) << std::endl;
+    }
+    PQclear(r);
+    PQclear(exec_simple(conn, Query::TX_COMMIT));
+
+    if (!ok) return nullptr;
+    return s;
+}
+
+// Свои записи должны быть видны следующему чтению из снимка и с реплик.
+// Известные строки и города сразу добавляются в снимок; без них (COPY, вставка
+// без RETURNING) — ожидание перезагрузки снимка, ограниченное по времени
+uint64_t Database::after_write(const std::vector<Integrator>& rows, const std::vector<City>& cities,
+                               bool known) {
+    if (replica) {
+        if (known) replica->apply(rows, cities);
+        else replica->sync();
+    }
+    uint64_t lsn = 0;
+    if (read_replicas) {
+        PooledConn conn = pool.acquire();
+        PGresult* r = exec(conn, Query::PRIMARY_WAL_LSN);
+        if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) lsn = parse_lsn(PQgetvalue(r, 0, 0));
+        PQclear(r);
+    }
+    return lsn;
+}
+
+SnapshotStats Database::snapshot_stats() const {
+    auto s = snapshot();
+    if (!s) return {false, 0, 0, 0, 0};
+    const IntegratorSet& set = s->integrators;
+    // Словари — по загруженной части; своих записей до перезагрузки немного
+    const IntegratorStore* st = set.parts().empty() ? nullptr : set.parts()[0].get();
+    return {true, set.size(), st ? st->distinct_cities() : 0, st ? st->distinct_activities() : 0,
+            set.memory_bytes()};
+}
+
+std::vector<ReplicaStatus> Database::replica_status() const {
+    return read_replicas ? read_replicas->status() : std::vector<ReplicaStatus>();
+}
+
+// Соединение для чтения: реплика по кругу, если она здорова и догнала min_lsn, иначе primary
+PooledConn Database::read_conn(uint64_t min_lsn) {
+    if (read_replicas) {
+        if (ConnectionPool* p = read_replicas->pick(min_lsn)) {
+            try {
+                return p->acquire();
+            } catch (const std::exception& e) {
+                std::cerr << "Replica acquire error: " << e.what() << std::endl;
+                read_replicas->mark_down(p);
+            }
+        }
+    }
+    return pool.acquire();
+}
+
+AsyncDatabase& Database::async() {
+    std::call_once(async_once, [this]() {
+        async_db.reset(new AsyncDatabase(conninfo, pool_cfg.async_connections));
+    });
+    return *async_db;
+}
+
+PoolStats Database::pool_stats() const {
+    return pool.stats();
+}
+
+std::vector<QueryStatsRow> Database::query_stats() const {
+    return key_stats.snapshot();
 }
 
 void Database::init() {
+    PooledConn conn = pool.acquire();
     PGresult* r;
     
     r = PQexec(conn, SQL::CREATE_CITIES);
@@ -84,32 +355,77 @@ void Database::init() {
     }
     PQclear(r);
     
+    for (const char* idx : {SQL::CREATE_INTEGRATORS_CITY_IDX, SQL::CREATE_INTEGRATORS_ACTIVITY_IDX}) {
+        r = PQexec(conn, idx);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            std::cerr << "Create index error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    
+    for (const char* ddl : {SQL::ALTER_INTEGRATORS_SEARCH_TSV, SQL::CREATE_INTEGRATORS_SEARCH_IDX}) {
+        r = PQexec(conn, ddl);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            std::cerr << "Create search index error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    
+    // Уведомления об изменениях для реплик в памяти (Replica)
+    for (const char* ddl : {SQL::CREATE_NOTIFY_FUNCTION, SQL::CREATE_CITIES_NOTIFY_TRIGGER,
+                            SQL::CREATE_INTEGRATORS_NOTIFY_TRIGGER}) {
+        r = PQexec(conn, ddl);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            std::cerr << "Create notify trigger error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    
+    r = PQexec(conn, SQL::CREATE_INTEGRATORS_STAGING);
+    if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+        std::cerr << "Create staging error: " << PQerrorMessage(conn) << std::endl;
+    }
+    PQclear(r);
+    
     r = PQexec(conn, SQL::CREATE_ADMIN);
     if (PQresultStatus(r) != PGRES_COMMAND_OK) {
         std::cerr << "Create admin error: " << PQerrorMessage(conn) << std::endl;
     }
     PQclear(r);
+
+    // Таблицы созданы — теперь все запросы можно готовить на каждом соединении пула
+    pool.set_on_connect(prepare_all);
+    prepare_all(conn.entry());
+
+    // Кэш городов заполняется целиком при старте, дальше — при промахах
+    r = exec(conn, Query::SELECT_CITIES, 0, NULL, 1);
+    for (const City& c : decode_cities(r)) city_cache.put(c.name, c.id);
+    PQclear(r);
+
+    // Схема на репликах приходит с primary, поэтому их пулы создаются после DDL
+    if (!replica_cfg.conninfos.empty() && !read_replicas)
+        read_replicas.reset(new ReadReplicas(conninfo, replica_cfg, prepare_all));
 }
 
 bool Database::has_admin() {
-    PGresult* r = PQexec(conn, SqlLoader::get("SELECT_ADMIN_COUNT").c_str());
+    PooledConn conn = pool.acquire();
+    PGresult* r = exec(conn, Query::SELECT_ADMIN_COUNT);
     bool exists = PQntuples(r) > 0;
     PQclear(r);
     return exists;
 }
 
 void Database::set_admin_password(const std::string& password) {
-    std::string h = sha256(password);
-    PGresult* r = PQexec(conn, SqlLoader::get("DELETE_ADMIN").c_str());
+    std::string h = hash_password(password, kdf_cfg.iterations);
+    PooledConn conn = pool.acquire();
+    PGresult* r = exec(conn, Query::DELETE_ADMIN);
     if (PQresultStatus(r) != PGRES_COMMAND_OK) {
         std::cerr << "Delete error: " << PQerrorMessage(conn) << std::endl;
     }
     PQclear(r);
     
     const char* values[] = {h.c_str()};
-    r = PQexecParams(conn,
-        SqlLoader::get("INSERT_ADMIN").c_str(),
-        1, NULL, values, NULL, NULL, 0);
+    r = exec(conn, Query::INSERT_ADMIN, 1, values);
     if (PQresultStatus(r) != PGRES_COMMAND_OK) {
         std::cerr << "Insert error: " << PQerrorMessage(conn) << std::endl;
     }
@@ -117,40 +433,644 @@ void Database::set_admin_password(const std::string& password) {
 }
 
 bool Database::check_admin_password(const std::string& password) {
-    std::string h = sha256(password);
-    const char* values[] = {h.c_str()};
-    PGresult* r = PQexecParams(conn,
-        SqlLoader::get("SELECT_ADMIN_BY_PASSWORD").c_str(),
-        1, NULL, values, NULL, NULL, 0);
-    bool ok = PQntuples(r) > 0;
-    PQclear(r);
-    return ok;
+    std::string stored;
+    {
+        PooledConn conn = pool.acquire();
+        PGresult* r = exec(conn, Query::SELECT_ADMIN_HASH);
+        if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) stored = PQgetvalue(r, 0, 0);
+        PQclear(r);
+    }
+    if (stored.empty()) return false;
+
+    // Проверка — на пуле хеширования, соединение с БД на это время уже возвращено
+    PasswordCheck c = check_password(hashers, password, stored, kdf_cfg.iterations);
+
+    if (!c.rehash.empty()) {
+        PooledConn conn = pool.acquire();
+        const char* values[] = {c.rehash.c_str(), stored.c_str()};
+        PGresult* r = exec(conn, Query::UPDATE_ADMIN_HASH, 2, values);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            std::cerr << "Rehash error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    return c.ok;
 }
 
 void Database::add_integrator(const std::string& n, int city_id, const std::string& a) {
-    std::string city_id_str = std::to_string(city_id);
-    const char* values[] = {n.c_str(), city_id_str.c_str(), a.c_str()};
-    PGresult* r = PQexecParams(conn,
-        SqlLoader::get("INSERT_INTEGRATOR").c_str(),
-        3, NULL, values, NULL, NULL, 0);
-    if (PQresultStatus(r) != PGRES_COMMAND_OK) {
-        std::cerr << "Insert error: " << PQerrorMessage(conn) << std::endl;
+    {
+        PooledConn conn = pool.acquire();
+        std::string city_id_str = std::to_string(city_id);
+        const char* values[] = {n.c_str(), city_id_str.c_str(), a.c_str()};
+        PGresult* r = exec(conn, Query::INSERT_INTEGRATOR, 3, values);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK) {
+            std::cerr << "Insert error: " << PQerrorMessage(conn) << std::endl;
+        }
+        PQclear(r);
+    }
+    // INSERT_INTEGRATOR не возвращает id
+    after_write({}, {}, false);
+}
+
+int Database::add_integrator_with_city(const std::string& name,
+                                       const std::string& city,
+                                       const std::string& activity,
+                                       uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    int id = -1, city_id = -1;
+    {
+        PooledConn conn = pool.acquire();
+        const char* values[] = {name.c_str(), city.c_str(), activity.c_str()};
+        // Пустой результат — город вставлен параллельной транзакцией и не виден
+        // снимку оператора; повтор его уже увидит
+        for (int attempt = 0; attempt < 2 && id < 0; attempt++) {
+            PGresult* r = exec(conn, Query::ADD_INTEGRATOR_WITH_CITY, 3, values, 1);
+            if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+                std::cerr << "Insert error: " << PQerrorMessage(conn) << std::endl;
+                PQclear(r);
+                break;
+            }
+            if (PQntuples(r) > 0) {
+                id = int(pg_int(r, 0, 0));
+                city_id = int(pg_int(r, 0, 1));
+            }
+            PQclear(r);
+        }
+    }
+    if (id < 0) return -1;
+    city_cache.put(city, city_id);
+    uint64_t lsn = after_write({{id, name, city, activity}}, {{city_id, city}});
+    if (commit_token) *commit_token = lsn;
+    return id;
+}
+
+IntegratorRows Database::get_integrators(uint64_t min_token) {
+    // Из снимка — без копирования: строки держат сам снимок
+    if (auto s = snapshot())
+        return set_rows(std::shared_ptr<const IntegratorSet>(s, &s->integrators));
+
+    PooledConn conn = read_conn(min_token);
+    PGresult* r = exec(conn, Query::SELECT_INTEGRATORS, 0, NULL, 1);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+        std::cerr << "Select error: " << PQerrorMessage(conn) << std::endl;
+    }
+    return pg_integrator_rows(r);
+}
+
+// Ключ запроса страницы и его параметры ($1 after, $2 limit, далее значения фильтров).
+// Для каждой комбинации фильтров свой запрос — иначе условие "$3 IS NULL OR ..." мешает индексу.
+static Query page_query(const IntegratorFilter& f, std::vector<const char*>& values) {
+    if (!f.city.empty()) values.push_back(f.city.c_str());
+    if (!f.activity.empty()) values.push_back(f.activity.c_str());
+    if (!f.city.empty() && !f.activity.empty()) return Query::SELECT_INTEGRATORS_PAGE_BY_CITY_ACTIVITY;
+    if (!f.city.empty()) return Query::SELECT_INTEGRATORS_PAGE_BY_CITY;
+    if (!f.activity.empty()) return Query::SELECT_INTEGRATORS_PAGE_BY_ACTIVITY;
+    return Query::SELECT_INTEGRATORS_PAGE;
+}
+
+IntegratorPage Database::get_integrators_page(int after_id, int limit, const IntegratorFilter& filter,
+                                              uint64_t min_token) {
+    if (auto s = snapshot())
+        return set_page(std::shared_ptr<const IntegratorSet>(s, &s->integrators), after_id, limit, filter);
+
+    PooledConn conn = read_conn(min_token);
+    // Берём на одну строку больше, чтобы узнать, есть ли следующая страница
+    std::string after = std::to_string(after_id);
+    std::string lim = std::to_string(limit + 1);
+    std::vector<const char*> values = {after.c_str(), lim.c_str()};
+    Query key = page_query(filter, values);
+    PGresult* r = exec(conn, key, int(values.size()), values.data(), 1);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+        std::cerr << "Select page error: " << PQerrorMessage(conn) << std::endl;
+        PQclear(r);
+        return {IntegratorRows(), -1, false};
     }
+
+    IntegratorPage page{pg_integrator_rows(r), -1};
+    if (int(page.items.size()) > limit) {
+        page.items.truncate(limit);
+        page.next_after = page.items.back().id;
+    }
+    return page;
+}
+
+long long Database::count_integrators(const IntegratorFilter& filter, uint64_t min_token) {
+    if (auto s = snapshot()) return s->integrators.count(filter);
+
+    PooledConn conn = read_conn(min_token);
+    const char* values[] = {filter.city.empty() ? NULL : filter.city.c_str(),
+                            filter.activity.empty() ? NULL : filter.activity.c_str()};
+    PGresult* r = exec(conn, Query::COUNT_INTEGRATORS, 2, values, 1);
+    long long n = -1;
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) n = pg_int(r, 0, 0);
+    else std::cerr << "Count error: " << PQerrorMessage(conn) << std::endl;
     PQclear(r);
+    return n;
 }
 
-std::vector<Integrator> Database::get_integrators() {
-    PGresult* r = PQexec(conn, SqlLoader::get("SELECT_INTEGRATORS").c_str());
-    std::vector<Integrator> v;
+// Текст ошибки результата без завершающего перевода строки
+static std::string result_error(const PGresult* r) {
+    std::string e = PQresultErrorMessage(r);
+    while (!e.empty() && (e.back() == '\n' || e.back() == ' ')) e.pop_back();
+    return e;
+}
 
-    for (int i = 0; i < PQntuples(r); i++) {
-        v.push_back({
-            std::stoi(PQgetvalue(r,i,0)),
-            PQgetvalue(r,i,1),
-            PQgetvalue(r,i,2),
-            PQgetvalue(r,i,3)
-        });
+SearchPage Database::search_integrators(const std::string& query, int limit, int offset,
+                                        uint64_t min_token) {
+    PooledConn conn = read_conn(min_token);
+    std::string lim = std::to_string(limit + 1);
+    std::string off = std::to_string(offset);
+    const char* values[] = {query.c_str(), lim.c_str(), off.c_str()};
+    PGresult* r = exec(conn, Query::SEARCH_INTEGRATORS, 3, values, 1);
+    if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+        std::cerr << "Search error: " << PQerrorMessage(conn) << std::endl;
+        PQclear(r);
+        return {IntegratorRows(), {}, -1, false};
     }
+
+    SearchPage page{pg_integrator_rows(r), {}, -1};
+    for (size_t i = 0; i < page.items.size(); i++) page.ranks.push_back(pg_float4(r, int(i), 4));
+    if (int(page.items.size()) > limit) {
+        page.items.truncate(limit);
+        page.ranks.resize(limit);
+        page.next_offset = offset + limit;
+    }
+    return page;
+}
+
+// Узел плана читает integrators индексом index: обычный, index-only или bitmap-скан
+static bool scans_with(const std::string& plan, const std::string& index) {
+    return plan.find("Index Scan using " + index + " on integrators") != std::string::npos ||
+           plan.find("Index Only Scan using " + index + " on integrators") != std::string::npos ||
+           plan.find("Bitmap Index Scan on " + index + " ") != std::string::npos;
+}
+
+std::vector<PlanCheck> Database::check_filter_plans(const std::vector<int>& sizes) {
+    std::vector<PlanCheck> checks;
+    // Отдельное соединение с временными таблицами: pg_temp стоит первым в search_path,
+    // поэтому запросы из queries.sql читают их вместо рабочих. Рабочие таблицы не
+    // блокируются на запись, SERIAL и триггеры не задеваются, мусора после не остаётся.
+    PGconn* conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "Plan check error: " << PQerrorMessage(conn) << std::endl;
+        PQfinish(conn);
+        return checks;
+    }
+
+    const char* setup =
+        "CREATE TEMP TABLE cities (LIKE public.cities INCLUDING INDEXES);"
+        "CREATE TEMP TABLE integrators (LIKE public.integrators INCLUDING INDEXES);"
+        "INSERT INTO cities(id, name) SELECT g, 'plan-check-' || g FROM generate_series(1, 300) g;";
+    const char* fill =
+        "INSERT INTO integrators(id, name, city_id, activity) "
+        "SELECT g, 'plan-check ' || g, 1 + g % 300, 'plan-check activity ' || (g % 200) "
+        "FROM generate_series($1::INTEGER + 1, $2::INTEGER) g";
+    // Копии индексов получают свои имена — их берём из каталога по первому столбцу
+    const char* index_names =
+        "SELECT i.relname, a.attname FROM pg_index x "
+        "JOIN pg_class i ON i.oid = x.indexrelid "
+        "JOIN pg_attribute a ON a.attrelid = x.indrelid AND a.attnum = x.indkey[0] "
+        "WHERE x.indrelid = 'pg_temp.integrators'::regclass AND a.attname IN ('city_id', 'activity')";
+
+    PGresult* r = PQexec(conn, setup);
+    bool ready = PQresultStatus(r) == PGRES_COMMAND_OK;
     PQclear(r);
-    return v;
+    std::string city_idx, activity_idx;
+    if (ready) {
+        r = PQexec(conn, index_names);
+        ready = PQresultStatus(r) == PGRES_TUPLES_OK;
+        for (int i = 0; ready && i < PQntuples(r); i++)
+            (std::string(PQgetvalue(r, i, 1)) == "city_id" ? city_idx : activity_idx) = PQgetvalue(r, i, 0);
+        PQclear(r);
+        ready = ready && !city_idx.empty() && !activity_idx.empty();
+    }
+    if (!ready) {
+        std::cerr << "Plan check error: " << PQerrorMessage(conn)
+                  << (city_idx.empty() || activity_idx.empty() ? " (no filter indexes on integrators)" : "")
+                  << std::endl;
+        PQfinish(conn);
+        return checks;
+    }
+
+    const IntegratorFilter filters[] = {
+        {"plan-check-1", ""},
+        {"", "plan-check activity 1"},
+        {"plan-check-1", "plan-check activity 1"},
+    };
+    std::vector<int> steps(sizes);
+    std::sort(steps.begin(), steps.end());
+    int filled = 0;
+    for (int size : steps) {
+        if (size <= filled) continue;
+        std::string from = std::to_string(filled), to = std::to_string(size);
+        const char* range[] = {from.c_str(), to.c_str()};
+        r = PQexecParams(conn, fill, 2, NULL, range, NULL, NULL, 0);
+        bool ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+        PQclear(r);
+        if (ok) {
+            r = PQexec(conn, "ANALYZE cities; ANALYZE integrators");
+            ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+            PQclear(r);
+        }
+        if (!ok) {
+            std::cerr << "Plan check error at " << size << " rows: " << PQerrorMessage(conn) << std::endl;
+            break;
+        }
+        filled = size;
+
+        for (auto& f : filters) {
+            std::string after = "0", lim = "101";
+            std::vector<const char*> values = {after.c_str(), lim.c_str()};
+            Query key = page_query(f, values);
+            std::string sql = "EXPLAIN " + std::string(SqlLoader::view(key));
+
+            PlanCheck pc{key, size, false, ""};
+            r = PQexecParams(conn, sql.c_str(), int(values.size()), NULL, values.data(), NULL, NULL, 0);
+            for (int i = 0; i < PQntuples(r); i++) {
+                pc.plan += PQgetvalue(r, i, 0);
+                pc.plan += "\n";
+            }
+            if (PQresultStatus(r) != PGRES_TUPLES_OK) pc.plan = result_error(r);
+            PQclear(r);
+            // Индекс по cities.name в подзапросе не в счёт: нужен скан integrators индексом фильтра
+            bool by_city = !f.city.empty() && scans_with(pc.plan, city_idx);
+            bool by_activity = !f.activity.empty() && scans_with(pc.plan, activity_idx);
+            pc.index_scan = (by_city || by_activity) &&
+                            pc.plan.find("Seq Scan on integrators") == std::string::npos;
+            checks.push_back(pc);
+        }
+    }
+
+    // Временные таблицы удаляются вместе с сессией
+    PQfinish(conn);
+    return checks;
+}
+
+std::vector<BatchRowResult> Database::add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                           uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    std::vector<BatchRowResult> res = insert_batch(rows);
+    std::vector<Integrator> added;
+    std::vector<City> cities;
+    std::set<std::string> seen;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (res[i].id < 0) continue;
+        added.push_back({res[i].id, rows[i].name, rows[i].city, rows[i].activity});
+        int city_id = city_cache.find(rows[i].city);
+        if (city_id >= 0 && seen.insert(rows[i].city).second) cities.push_back({city_id, rows[i].city});
+    }
+    // Транзакция пакета откатилась целиком — ждать на репликах нечего
+    if (added.empty()) return res;
+    uint64_t lsn = after_write(added, cities);
+    if (commit_token) *commit_token = lsn;
+    return res;
+}
+
+std::vector<BatchRowResult> Database::insert_batch(const std::vector<NewIntegrator>& rows) {
+    const char* not_done = "не выполнено: транзакция отменена";
+    std::vector<BatchRowResult> res(rows.size(), BatchRowResult{-1, not_done});
+    if (rows.empty()) return res;
+
+    // Upsert нужен только городам, которых нет в кэше
+    std::vector<const std::string*> cities;
+    std::set<std::string> seen;
+    for (auto& row : rows)
+        if (city_cache.find(row.city) < 0 && seen.insert(row.city).second) cities.push_back(&row.city);
+    std::vector<int> city_ids(cities.size(), -1);
+
+    PooledConn conn = pool.acquire();
+    for (Query key : {Query::INSERT_CITY, Query::INSERT_INTEGRATOR_BY_CITY_NAME}) {
+        if (PGresult* p = prepare(conn.entry(), key)) {
+            for (auto& x : res) x.error = result_error(p);
+            PQclear(p);
+            return res;
+        }
+    }
+    if (!PQenterPipelineMode(conn)) {
+        for (auto& x : res) x.error = PQerrorMessage(conn);
+        return res;
+    }
+
+    // Команды: BEGIN, upsert каждого города, вставка каждой строки, COMMIT.
+    // Интегратор находит id города подзапросом — upsert выше в той же транзакции.
+    // Результаты читаются окнами, чтобы буферы сокета не переполнились на больших пакетах.
+    const size_t window = 500;
+    const size_t first_row = 1 + cities.size();
+    const size_t commit_cmd = first_row + rows.size();
+    size_t sent = 0, read = 0;
+    bool failed = false;
+    std::string first_error;
+
+    auto read_one = [&]() {
+        PGresult* r = PQgetResult(conn);
+        if (!r) { failed = true; read++; return; }
+        ExecStatusType st = PQresultStatus(r);
+        if (st == PGRES_FATAL_ERROR) {
+            failed = true;
+            if (first_error.empty()) first_error = result_error(r);
+            if (read >= first_row && read < commit_cmd) res[read - first_row].error = result_error(r);
+        } else if (st == PGRES_TUPLES_OK && read >= first_row && read < commit_cmd && PQntuples(r) > 0) {
+            res[read - first_row] = {int(pg_int(r, 0, 0)), ""};
+        } else if (st == PGRES_TUPLES_OK && read >= 1 && read < first_row && PQntuples(r) > 0) {
+            city_ids[read - 1] = int(pg_int(r, 0, 0));
+        }
+        PQclear(r);
+        PQgetResult(conn);  // NULL — конец результатов команды
+        read++;
+    };
+    auto after_send = [&]() {
+        sent++;
+        if (sent - read >= window) {
+            PQsendFlushRequest(conn);
+            PQflush(conn);
+            while (read < sent) read_one();
+        }
+    };
+
+    auto t0 = Clock::now();
+    PQsendQueryParams(conn, "BEGIN", 0, NULL, NULL, NULL, NULL, 0);
+    after_send();
+    for (size_t i = 0; i < cities.size() && !failed; i++) {
+        const char* values[] = {cities[i]->c_str()};
+        PQsendQueryPrepared(conn, SqlLoader::name(Query::INSERT_CITY), 1, values, NULL, NULL, 1);
+        after_send();
+    }
+    for (size_t i = 0; i < rows.size() && !failed; i++) {
+        const char* values[] = {rows[i].name.c_str(), rows[i].city.c_str(), rows[i].activity.c_str()};
+        PQsendQueryPrepared(conn, SqlLoader::name(Query::INSERT_INTEGRATOR_BY_CITY_NAME), 3, values, NULL, NULL, 1);
+        after_send();
+    }
+    if (!failed) {
+        PQsendQueryParams(conn, "COMMIT", 0, NULL, NULL, NULL, NULL, 0);
+        sent++;
+    }
+    PQpipelineSync(conn);
+    while (read < sent) read_one();
+    while (PGresult* r = PQgetResult(conn)) {
+        bool sync = PQresultStatus(r) == PGRES_PIPELINE_SYNC;
+        PQclear(r);
+        if (sync) break;
+    }
+    PQexitPipelineMode(conn);
+    // Пакет учитывается одной записью: время всего pipeline и число вставленных строк
+    key_stats.record(Query::INSERT_INTEGRATOR_BY_CITY_NAME, Clock::now() - t0,
+                       failed ? 0 : rows.size(), 0, failed);
+
+    if (failed) {
+        std::cerr << "Batch insert error: " << first_error << std::endl;
+        if (PQtransactionStatus(conn) != PQTRANS_IDLE) PQclear(exec_simple(conn, Query::TX_ROLLBACK));
+        for (auto& x : res) {
+            if (x.id >= 0) x = {-1, not_done};
+            else if (x.error == not_done && !first_error.empty()) x.error = std::string(not_done) + " (" + first_error + ")";
+        }
+    } else {
+        for (size_t i = 0; i < cities.size(); i++)
+            if (city_ids[i] >= 0) city_cache.put(*cities[i], city_ids[i]);
+    }
+    return res;
+}
+
+ImportStats Database::import_integrators_csv(const CsvSource& source, bool header, uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    ImportStats st = import_csv(source, header);
+    if (!st.ok) return st;
+    uint64_t lsn = after_write({}, {}, false);
+    if (commit_token) *commit_token = lsn;
+    return st;
+}
+
+ImportStats Database::import_csv(const CsvSource& source, bool header) {
+    auto t0 = std::chrono::steady_clock::now();
+    ImportStats st{false, "", 0, 0};
+    PooledConn conn = pool.acquire();
+
+    // Шаг транзакции; при ошибке запоминает текст и откатывает транзакцию
+    auto step = [&](PGresult* r, const char* what) {
+        ExecStatusType s = PQresultStatus(r);
+        bool ok = s == PGRES_COMMAND_OK || s == PGRES_TUPLES_OK;
+        if (!ok) {
+            st.error = std::string(what) + ": " + result_error(r);
+            std::cerr << "Import error: " << st.error << std::endl;
+            PQclear(exec_simple(conn, Query::TX_ROLLBACK));
+        }
+        PQclear(r);
+        return ok;
+    };
+
+    // TRUNCATE держит блокировку до конца транзакции — параллельные импорты идут по очереди
+    if (!step(exec_simple(conn, Query::TX_BEGIN), "begin") ||
+        !step(exec(conn, Query::IMPORT_TRUNCATE_STAGING), "truncate"))
+        return st;
+
+    Query copy_key = header ? Query::COPY_STAGING_CSV_HEADER : Query::COPY_STAGING_CSV;
+    auto copy_t0 = Clock::now();
+    PGresult* r = PQexec(conn, SqlLoader::get(copy_key));
+    if (PQresultStatus(r) != PGRES_COPY_IN) {
+        key_stats.record(copy_key, Clock::now() - copy_t0, r);
+        step(r, "copy");
+        return st;
+    }
+    PQclear(r);
+
+    uint64_t copy_bytes = 0;
+    bool read_ok = source([&](const char* data, size_t len) {
+        copy_bytes += len;
+        return PQputCopyData(conn, data, int(len)) == 1;
+    });
+    PQputCopyEnd(conn, read_ok ? NULL : "источник данных прерван");
+    r = PQgetResult(conn);
+    while (PGresult* extra = PQgetResult(conn)) PQclear(extra);
+    // Для COPY FROM в bytes — отправленные данные
+    bool copy_ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+    key_stats.record(copy_key, Clock::now() - copy_t0,
+                       copy_ok ? std::strtoull(PQcmdTuples(r), nullptr, 10) : 0, copy_bytes, !copy_ok);
+    if (!step(r, "copy")) return st;
+
+    r = exec(conn, Query::IMPORT_MERGE_CITIES);
+    if (!step(r, "merge cities")) return st;
+
+    r = exec(conn, Query::IMPORT_MERGE_INTEGRATORS);
+    long long rows = PQresultStatus(r) == PGRES_COMMAND_OK ? std::atoll(PQcmdTuples(r)) : 0;
+    if (!step(r, "merge integrators")) return st;
+
+    if (!step(exec(conn, Query::IMPORT_TRUNCATE_STAGING), "truncate") ||
+        !step(exec_simple(conn, Query::TX_COMMIT), "commit"))
+        return st;
+
+    st.ok = true;
+    st.rows = rows;
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return st;
+}
+
+// Отмена выполняющегося запроса на соединении
+static void cancel_query(PGconn* conn) {
+    char err[256];
+    PGcancel* cancel = PQgetCancel(conn);
+    PQcancel(cancel, err, sizeof(err));
+    PQfreeCancel(cancel);
+}
+
+bool Database::export_integrators_csv(const CsvSink& sink) {
+    PooledConn conn = read_conn(0);
+    auto t0 = Clock::now();
+    PGresult* r = PQexec(conn, SqlLoader::get(Query::COPY_INTEGRATORS_CSV));
+    if (PQresultStatus(r) != PGRES_COPY_OUT) {
+        key_stats.record(Query::COPY_INTEGRATORS_CSV, Clock::now() - t0, r);
+        std::cerr << "Export error: " << PQerrorMessage(conn) << std::endl;
+        PQclear(r);
+        return false;
+    }
+    PQclear(r);
+
+    // Строки COPY копятся в буфер и уходят в sink кусками, а не по одной
+    const size_t flush_size = 64 * 1024;
+    std::string out;
+    out.reserve(flush_size + 1024);
+    bool stopped = false;
+    uint64_t rows = 0, bytes = 0;
+    char* buf = NULL;
+    int len;
+    while ((len = PQgetCopyData(conn, &buf, 0)) > 0) {
+        rows++;
+        bytes += size_t(len);
+        if (!stopped) {
+            out.append(buf, size_t(len));
+            if (out.size() >= flush_size) {
+                if (!sink(out.data(), out.size())) {
+                    stopped = true;
+                    cancel_query(conn);
+                }
+                out.clear();
+            }
+        }
+        PQfreemem(buf);
+    }
+
+    bool ok = len == -1;
+    if (ok && !stopped && !out.empty() && !sink(out.data(), out.size())) stopped = true;
+    while (PGresult* res = PQgetResult(conn)) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) ok = false;
+        PQclear(res);
+    }
+    // Для COPY TO: строки и байты CSV; отмена по запросу клиента — не ошибка БД
+    key_stats.record(Query::COPY_INTEGRATORS_CSV, Clock::now() - t0, rows, bytes, !ok && !stopped);
+    if (!ok && !stopped) std::cerr << "Export error: " << PQerrorMessage(conn) << std::endl;
+    return ok && !stopped;
+}
+
+bool Database::for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn,
+                                   uint64_t min_token) {
+    if (auto s = snapshot()) {
+        s->integrators.visit([&](uint32_t i) { return fn(s->integrators.row(i)); });
+        return true;
+    }
+
+    PooledConn conn = read_conn(min_token);
+    if (PGresult* p = prepare(conn.entry(), Query::SELECT_INTEGRATORS)) {
+        std::cerr << "Prepare error: " << PQerrorMessage(conn) << std::endl;
+        PQclear(p);
+        return false;
+    }
+    auto t0 = Clock::now();
+    if (!PQsendQueryPrepared(conn, SqlLoader::name(Query::SELECT_INTEGRATORS), 0, NULL, NULL, NULL, 1)) {
+        std::cerr << "Select error: " << PQerrorMessage(conn) << std::endl;
+        key_stats.record(Query::SELECT_INTEGRATORS, Clock::now() - t0, 0, 0, true);
+        return false;
+    }
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    PQsetChunkedRowsMode(conn, 256);
+#else
+    PQsetSingleRowMode(conn);
+#endif
+
+    bool ok = true;
+    bool stopped = false;
+    uint64_t n_rows = 0, n_bytes = 0;
+    while (PGresult* r = PQgetResult(conn)) {
+        ExecStatusType st = PQresultStatus(r);
+        bool rows = st == PGRES_SINGLE_TUPLE;
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        rows = rows || st == PGRES_TUPLES_CHUNK;
+#endif
+        if (rows && !stopped) {
+            for (int i = 0; i < PQntuples(r); i++) {
+                n_rows++;
+                for (int j = 0; j < 4; j++) n_bytes += PQgetlength(r, i, j);
+                IntegratorRef it{int(pg_int(r,i,0)), pg_text(r,i,1), pg_text(r,i,2), pg_text(r,i,3)};
+                if (!fn(it)) {
+                    // Остаток выборки не нужен: отменяем запрос и дочитываем до конца
+                    stopped = true;
+                    cancel_query(conn);
+                    break;
+                }
+            }
+        } else if (st != PGRES_TUPLES_OK && !rows && !stopped) {
+            std::cerr << "Select error: " << PQerrorMessage(conn) << std::endl;
+            ok = false;
+        }
+        PQclear(r);
+    }
+    // Время построчной выдачи включает обработку строк колбэком (запись в ответ)
+    key_stats.record(Query::SELECT_INTEGRATORS, Clock::now() - t0, n_rows, n_bytes, !ok);
+    return ok;
+}
+
+DecodeBenchmark Database::benchmark_decode(int rows) {
+    auto ms = [](Clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+    PooledConn conn = pool.acquire();
+    std::string n = std::to_string(rows);
+    const char* values[] = {n.c_str()};
+    DecodeBenchmark b{rows, 0, 0, 0, 0};
+
+    for (int format = 0; format <= 1; format++) {
+        auto t0 = Clock::now();
+        PGresult* r = exec(conn, Query::BENCH_INTEGRATORS, 1, values, format);
+        auto t1 = Clock::now();
+        if (PQresultStatus(r) != PGRES_TUPLES_OK) {
+            std::cerr << "Benchmark error: " << PQerrorMessage(conn) << std::endl;
+            PQclear(r);
+            return b;
+        }
+        size_t decoded = format ? decode_integrators(r).size()
+                                : decode_integrators_text(r).size();
+        auto t2 = Clock::now();
+        PQclear(r);
+
+        b.rows = int(decoded);
+        (format ? b.binary_fetch_ms : b.text_fetch_ms) = ms(t1 - t0);
+        (format ? b.binary_decode_ms : b.text_decode_ms) = ms(t2 - t1);
+    }
+    return b;
+}
+
+QueryReload Database::reload_queries() {
+    std::unique_ptr<SqlLoader::Table> next;
+    try {
+        next = SqlLoader::read();
+    } catch (const std::exception& e) {
+        return {false, e.what(), SqlLoader::version()};
+    }
+
+    // Проверка на отдельном соединении: безымянный запрос не пересекается с рабочими
+    PGconn* conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::string error = PQerrorMessage(conn);
+        PQfinish(conn);
+        return {false, error, SqlLoader::version()};
+    }
+    std::string error;
+    for (size_t i = 0; i < QUERY_COUNT && error.empty(); i++) {
+        Query q = Query(i);
+        if (!SqlLoader::preparable(q)) continue;
+        PGresult* r = PQprepare(conn, "", next->sql[i].c_str(), 0, NULL);
+        if (PQresultStatus(r) != PGRES_COMMAND_OK)
+            error = std::string(SqlLoader::name(q)) + ": " + result_error(r);
+        PQclear(r);
+    }
+    PQfinish(conn);
+    if (!error.empty()) return {false, error, SqlLoader::version()};
+
+    return {true, "", SqlLoader::publish(std::move(next))};
 }
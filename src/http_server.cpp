@@ -1,14 +1,19 @@
 #include "http_server.h"
+#include "db.h"
+#include "session.h"
+#include "password.h"
 #include <fstream>
 #include <sstream>
 #include <thread>
 #include <cstdio>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
 #include "httplib.h"
 using namespace httplib;
 
-static std::string escape_json(const std::string& str) {
-    std::string result;
+static void append_json(std::string& result, std::string_view str) {
     for (unsigned char c : str) {
         switch (c) {
             case '"': result += "\\\""; break;
@@ -28,12 +33,46 @@ static std::string escape_json(const std::string& str) {
                 }
         }
     }
-    return result;
 }
 
-void start_http_server(Database& db) {
-    std::thread([&db]() {
+// Токен сессии: заголовок "Authorization: Bearer <token>" или параметр token
+static std::string request_token(const Request& req) {
+    auto auth = req.get_header_value("Authorization");
+    const std::string bearer = "Bearer ";
+    if (auth.compare(0, bearer.size(), bearer) == 0) return auth.substr(bearer.size());
+    return req.get_param_value("token");
+}
+
+static bool authorize(SessionStore& sessions, const Request& req, Response& res) {
+    if (sessions.validate(request_token(req))) return true;
+    res.status = 403;
+    res.set_content("forbidden", "text/plain");
+    return false;
+}
+
+// extra — готовые поля вида ,"key":value, дописываются перед закрывающей скобкой
+static void append_integrator_json(std::string& out, const IntegratorRef& it, std::string_view extra = {}) {
+    out += "{\"id\":";
+    out += std::to_string(it.id);
+    out += ",\"name\":\"";
+    append_json(out, it.name);
+    out += "\",\"city\":\"";
+    append_json(out, it.city);
+    out += "\",\"activity\":\"";
+    append_json(out, it.activity);
+    out += '"';
+    out += extra;
+    out += '}';
+}
+
+size_t http_worker_count() {
+    return CPPHTTPLIB_THREAD_POOL_COUNT;
+}
+
+void start_http_server(Storage& db, WriteBehind* writes, Database* pg) {
+    std::thread([&db, writes, pg]() {
         Server svr;
+        SessionStore sessions;
 
         // HTML
         svr.Get("/", [](const Request&, Response& res) {
@@ -48,58 +87,286 @@ void start_http_server(Database& db) {
             res.set_content(buf.str(), "text/html; charset=utf-8");
         });
 
-        // Получить список интеграторов
-        svr.Get("/list", [&db](const Request&, Response& res) {
-            auto list = db.get_integrators();
-            std::ostringstream json;
-            json << "[";
-
-            for (size_t i = 0; i < list.size(); ++i) {
-                const auto& it = list[i];
-                json << "{"
-                     << "\"id\":" << it.id << ","
-                     << "\"name\":\"" << escape_json(it.name) << "\","
-                     << "\"city\":\"" << escape_json(it.city) << "\","
-                     << "\"activity\":\"" << escape_json(it.activity) << "\"}";
-                if (i + 1 < list.size()) json << ",";
+        // Получить список интеграторов.
+        // С параметрами after/limit/city/activity — одна страница с фильтром:
+        // {"items":[...],"next":курсор|null}.
+        // Без них — вся таблица: строки идут из БД прямо в chunked-ответ,
+        // в памяти держится только буфер в несколько КБ
+        svr.Get("/list", [&db, &sessions](const Request& req, Response& res) {
+            // Админ после записи читает с реплик, уже применивших его изменения
+            uint64_t min_lsn = sessions.write_lsn(request_token(req));
+            if (req.has_param("after") || req.has_param("limit") ||
+                req.has_param("city") || req.has_param("activity")) {
+                int after = std::atoi(req.get_param_value("after").c_str());
+                int limit = req.has_param("limit") ? std::atoi(req.get_param_value("limit").c_str()) : 100;
+                limit = std::max(1, std::min(limit, 1000));
+                IntegratorFilter filter{req.get_param_value("city"), req.get_param_value("activity")};
+
+                auto page = db.get_integrators_page(after, limit, filter, min_lsn);
+                if (!page.ok) {
+                    res.status = 500;
+                    res.set_content("db error", "text/plain");
+                    return;
+                }
+                std::string json = "{\"items\":[";
+                for (size_t i = 0; i < page.items.size(); ++i) {
+                    if (i) json += ',';
+                    append_integrator_json(json, page.items[i]);
+                }
+                json += "],\"next\":";
+                json += page.next_after < 0 ? "null" : std::to_string(page.next_after);
+                json += "}";
+                res.set_content(json, "application/json; charset=utf-8");
+                return;
+            }
+
+            res.set_chunked_content_provider("application/json; charset=utf-8",
+                [&db, min_lsn](size_t, DataSink& sink) {
+                    const size_t flush_size = 16 * 1024;
+                    std::string buf = "[";
+                    bool first = true;
+                    bool sent = true;
+
+                    // Провайдер вызывается вне обработчика исключений httplib
+                    bool ok = false;
+                    try {
+                        auto add = [&](const IntegratorRef& it) {
+                            if (!first) buf += ',';
+                            first = false;
+                            append_integrator_json(buf, it);
+                            if (buf.size() >= flush_size) {
+                                sent = sink.write(buf.data(), buf.size());
+                                buf.clear();
+                            }
+                            return sent;
+                        };
+                        ok = db.for_each_integrator(add, min_lsn);
+                    } catch (const std::exception& e) {
+                        std::cerr << "List error: " << e.what() << std::endl;
+                    }
+                    // Ошибка БД или клиент отключился — обрываем ответ
+                    if (!ok || !sent) return false;
+
+                    buf += "]";
+                    if (!sink.write(buf.data(), buf.size())) return false;
+                    sink.done();
+                    return true;
+                });
+        });
+
+        // Количество по фильтру: /count?city=&activity= -> {"count":N}
+        svr.Get("/count", [&db, &sessions](const Request& req, Response& res) {
+            IntegratorFilter filter{req.get_param_value("city"), req.get_param_value("activity")};
+            long long n = db.count_integrators(filter, sessions.write_lsn(request_token(req)));
+            if (n < 0) {
+                res.status = 500;
+                res.set_content("db error", "text/plain");
+                return;
+            }
+            res.set_content("{\"count\":" + std::to_string(n) + "}", "application/json");
+        });
+
+        // Полнотекстовый поиск: /search?q=...&limit=&offset=
+        // Ответ {"items":[{...,"rank":...}],"next":смещение|null}
+        svr.Get("/search", [&db, &sessions](const Request& req, Response& res) {
+            std::string q = req.get_param_value("q");
+            if (q.empty()) {
+                res.status = 400;
+                res.set_content("empty query", "text/plain");
+                return;
+            }
+            int limit = req.has_param("limit") ? std::atoi(req.get_param_value("limit").c_str()) : 20;
+            limit = std::max(1, std::min(limit, 100));
+            int offset = std::max(0, std::atoi(req.get_param_value("offset").c_str()));
+
+            auto page = db.search_integrators(q, limit, offset, sessions.write_lsn(request_token(req)));
+            if (!page.ok) {
+                res.status = 500;
+                res.set_content("db error", "text/plain");
+                return;
+            }
+            std::string json = "{\"items\":[";
+            for (size_t i = 0; i < page.items.size(); ++i) {
+                if (i) json += ',';
+                append_integrator_json(json, page.items[i], ",\"rank\":" + std::to_string(page.ranks[i]));
+            }
+            json += "],\"next\":";
+            json += page.next_offset < 0 ? "null" : std::to_string(page.next_offset);
+            json += "}";
+            res.set_content(json, "application/json; charset=utf-8");
+        });
+
+        // Статистика запросов по ключам queries.sql:
+        // [{"key":...,"count":...,"errors":...,"rows":...,"bytes":...,"mean_ms":...,"p50_ms":...,...}]
+        // Без PostgreSQL — пустой список
+        svr.Get("/stats", [pg](const Request&, Response& res) {
+            std::string json = "[";
+            char buf[160];
+            for (auto& q : pg ? pg->query_stats() : std::vector<QueryStatsRow>()) {
+                if (json.size() > 1) json += ',';
+                json += "{\"key\":\"";
+                json += SqlLoader::name(q.key);
+                snprintf(buf, sizeof(buf),
+                         "\",\"count\":%llu,\"errors\":%llu,\"rows\":%llu,\"bytes\":%llu",
+                         (unsigned long long)q.count, (unsigned long long)q.errors,
+                         (unsigned long long)q.rows, (unsigned long long)q.bytes);
+                json += buf;
+                snprintf(buf, sizeof(buf),
+                         ",\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+                         q.mean_ms, q.p50_ms, q.p95_ms, q.p99_ms, q.max_ms);
+                json += buf;
             }
-            json << "]";
-            res.set_content(json.str(), "application/json; charset=utf-8");
+            json += "]";
+            res.set_content(json, "application/json");
         });
 
-        // Логин админа
-        svr.Post("/admin_login", [&db](const Request& req, Response& res) {
+        // Выгрузка всех интеграторов в CSV: куски COPY TO STDOUT идут в ответ без разбора строк
+        svr.Get("/export", [&db](const Request&, Response& res) {
+            res.set_header("Content-Disposition", "attachment; filename=\"integrators.csv\"");
+            res.set_chunked_content_provider("text/csv; charset=utf-8",
+                [&db](size_t, DataSink& sink) {
+                    bool ok = false;
+                    try {
+                        ok = db.export_integrators_csv([&sink](const char* data, size_t len) {
+                            return sink.write(data, len);
+                        });
+                    } catch (const std::exception& e) {
+                        std::cerr << "Export error: " << e.what() << std::endl;
+                    }
+                    if (!ok) return false;
+                    sink.done();
+                    return true;
+                });
+        });
+
+        // Логин админа: пароль проверяется один раз, в ответ — токен сессии,
+        // которым подписываются остальные admin-запросы
+        svr.Post("/admin_login", [&db, &sessions](const Request& req, Response& res) {
             auto pass = req.get_param_value("admin");
-            if (db.check_admin_password(pass)) {
-                res.set_content("ok", "text/plain");
+            bool ok;
+            try {
+                ok = db.check_admin_password(pass);
+            } catch (const HashQueueFull&) {
+                res.status = 503;
+                res.set_header("Retry-After", "1");
+                res.set_content("busy", "text/plain");
+                return;
+            }
+            if (ok) {
+                res.set_content(sessions.create(), "text/plain");
             } else {
                 res.status = 403;
                 res.set_content("bad password", "text/plain");
             }
         });
 
+        svr.Post("/admin_logout", [&sessions](const Request& req, Response& res) {
+            sessions.remove(request_token(req));
+            res.set_content("ok", "text/plain");
+        });
+
         // Добавление интегратора
-        svr.Post("/admin_add", [&db](const Request& req, Response& res) {
-            if (!db.check_admin_password(req.get_param_value("admin"))) {
-                res.status = 403;
-                res.set_content("forbidden", "text/plain");
+        // При включённой отложенной записи ответ приходит после коммита пачки с этой строкой
+        svr.Post("/admin_add", [&db, &sessions, writes](const Request& req, Response& res) {
+            if (!authorize(sessions, req, res)) return;
+
+            int id;
+            uint64_t lsn;
+            if (writes) {
+                QueuedWrite w;
+                try {
+                    w = writes->add({req.get_param_value("name"), req.get_param_value("city"),
+                                     req.get_param_value("activity")});
+                } catch (const WriteQueueFull&) {
+                    res.status = 503;
+                    res.set_header("Retry-After", "1");
+                    res.set_content("busy", "text/plain");
+                    return;
+                }
+                id = w.id;
+                lsn = w.lsn;
+            } else {
+                id = db.add_integrator_with_city(
+                    req.get_param_value("name"),
+                    req.get_param_value("city"),
+                    req.get_param_value("activity"),
+                    &lsn
+                );
+            }
+            if (id < 0) {
+                res.status = 400;
+                res.set_content("insert error", "text/plain");
                 return;
             }
+            sessions.note_write(request_token(req), lsn);
+
+            res.set_content("added", "text/plain");
+        });
+
+        // Пакетное добавление: тело — строки "название<TAB>город<TAB>деятельность",
+        // токен сессии в заголовке Authorization или параметре token. Ответ — по строке на запись: "ok <id>" или "error <текст>".
+        svr.Post("/admin_add_batch", [&db, &sessions](const Request& req, Response& res) {
+            if (!authorize(sessions, req, res)) return;
+
+            std::istringstream body(req.body);
+            auto rows = parse_integrators_tsv(body);
+            uint64_t lsn;
+            std::vector<BatchRowResult> results = db.add_integrators_batch(rows, &lsn);
+
+            std::string out;
+            bool all_ok = true;
+            for (auto& r : results) {
+                if (r.id >= 0) {
+                    out += "ok " + std::to_string(r.id) + "\n";
+                } else {
+                    out += "error " + r.error + "\n";
+                    all_ok = false;
+                }
+            }
+            // Пакет откатывается целиком: запись была, только если прошли все строки
+            if (all_ok && !results.empty()) sessions.note_write(request_token(req), lsn);
+            if (!all_ok) res.status = 400;
+            res.set_content(out, "text/plain; charset=utf-8");
+        });
+
+        // Импорт CSV: тело читается потоком прямо в COPY, без буферизации в Request::body.
+        // Нужен токен сессии, header=1 если первая строка — заголовок.
+        svr.Post("/admin_import", [&db, &sessions](const Request& req, Response& res,
+                                                   const ContentReader& content_reader) {
+            if (!authorize(sessions, req, res)) return;
 
-            int city_id = db.add_city(req.get_param_value("city"));
-            if (city_id < 0) {
+            CsvSource source = [&](const CsvSink& sink) {
+                return content_reader([&](const char* data, size_t len) {
+                    return sink(data, len);
+                });
+            };
+            bool header = req.get_param_value("header") == "1";
+            uint64_t lsn;
+            ImportStats st = db.import_integrators_csv(source, header, &lsn);
+
+            if (!st.ok) {
                 res.status = 400;
-                res.set_content("city error", "text/plain");
+                res.set_content("import error: " + st.error, "text/plain; charset=utf-8");
                 return;
             }
+            sessions.note_write(request_token(req), lsn);
+            std::ostringstream out;
+            out << "imported " << st.rows << " rows in " << st.seconds << " s ("
+                << static_cast<long long>(st.rows_per_sec()) << " rows/s)";
+            res.set_content(out.str(), "text/plain");
+        });
 
-            db.add_integrator(
-                req.get_param_value("name"),
-                city_id,
-                req.get_param_value("activity")
-            );
-
-            res.set_content("added", "text/plain");
+        // Перечитать queries.sql без перезапуска (то же делает SIGHUP)
+        svr.Post("/admin_reload_sql", [pg, &sessions](const Request& req, Response& res) {
+            if (!authorize(sessions, req, res)) return;
+            QueryReload r = pg ? pg->reload_queries()
+                               : QueryReload{false, "queries.sql is used only by PostgreSQL", 0};
+            if (!r.ok) {
+                res.status = 400;
+                res.set_content("reload error: " + r.error, "text/plain; charset=utf-8");
+                return;
+            }
+            res.set_content("reloaded, version " + std::to_string(r.version), "text/plain");
         });
 
         svr.listen("0.0.0.0", 8080);
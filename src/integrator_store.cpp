@@ -0,0 +1,120 @@
+#include "integrator_store.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+void IntegratorStore::reserve(size_t rows, size_t name_bytes) {
+    ids.reserve(rows);
+    name_off.reserve(rows + 1);
+    names.reserve(name_bytes);
+    city_codes.reserve(rows);
+    activity_codes.reserve(rows);
+}
+
+IntegratorStore::Code IntegratorStore::intern(Dict& dict, Index& index, std::string_view value) {
+    auto it = index.find(value);
+    if (it != index.end()) return it->second;
+    Code c = Code(dict.size());
+    dict.emplace_back(value);
+    index.emplace(dict.back(), c);
+    return c;
+}
+
+void IntegratorStore::add(int id, std::string_view name, std::string_view city, std::string_view activity) {
+    if (names.size() + name.size() > UINT32_MAX) throw std::runtime_error("integrator store: names too large");
+    ids.push_back(id);
+    names.append(name);
+    name_off.push_back(uint32_t(names.size()));
+    city_codes.push_back(intern(cities, city_index, city));
+    activity_codes.push_back(intern(activities, activity_index, activity));
+}
+
+void IntegratorStore::finish() {
+    if (std::is_sorted(ids.begin(), ids.end())) return;
+
+    std::vector<uint32_t> order(ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+
+    IntegratorStore sorted;
+    sorted.reserve(ids.size(), names.size());
+    for (uint32_t i : order) {
+        sorted.ids.push_back(ids[i]);
+        std::string_view n = name(i);
+        sorted.names.append(n);
+        sorted.name_off.push_back(uint32_t(sorted.names.size()));
+        sorted.city_codes.push_back(city_codes[i]);
+        sorted.activity_codes.push_back(activity_codes[i]);
+    }
+    ids.swap(sorted.ids);
+    name_off.swap(sorted.name_off);
+    names.swap(sorted.names);
+    city_codes.swap(sorted.city_codes);
+    activity_codes.swap(sorted.activity_codes);
+}
+
+std::optional<IntegratorStore::Code> IntegratorStore::city_code(std::string_view city) const {
+    auto it = city_index.find(city);
+    if (it == city_index.end()) return std::nullopt;
+    return it->second;
+}
+
+std::optional<IntegratorStore::Code> IntegratorStore::activity_code(std::string_view activity) const {
+    auto it = activity_index.find(activity);
+    if (it == activity_index.end()) return std::nullopt;
+    return it->second;
+}
+
+size_t IntegratorStore::upper_bound(int after_id) const {
+    return size_t(std::upper_bound(ids.begin(), ids.end(), after_id) - ids.begin());
+}
+
+size_t IntegratorStore::scan(size_t from, std::optional<Code> city, std::optional<Code> activity,
+                             size_t limit, std::vector<uint32_t>& out) const {
+    size_t n = ids.size();
+    size_t i = from;
+    // Отдельный цикл на каждую комбинацию фильтров: в теле только сравнение кодов
+    if (city && activity) {
+        const Code c = *city, a = *activity;
+        for (; i < n && limit; i++)
+            if (city_codes[i] == c && activity_codes[i] == a) { out.push_back(uint32_t(i)); limit--; }
+    } else if (city) {
+        const Code c = *city;
+        for (; i < n && limit; i++)
+            if (city_codes[i] == c) { out.push_back(uint32_t(i)); limit--; }
+    } else if (activity) {
+        const Code a = *activity;
+        for (; i < n && limit; i++)
+            if (activity_codes[i] == a) { out.push_back(uint32_t(i)); limit--; }
+    } else {
+        for (; i < n && limit; i++, limit--) out.push_back(uint32_t(i));
+    }
+    return i;
+}
+
+size_t IntegratorStore::count(std::optional<Code> city, std::optional<Code> activity) const {
+    size_t n = ids.size();
+    size_t k = 0;
+    if (city && activity) {
+        const Code c = *city, a = *activity;
+        for (size_t i = 0; i < n; i++) k += (city_codes[i] == c) & (activity_codes[i] == a);
+    } else if (city) {
+        const Code c = *city;
+        for (size_t i = 0; i < n; i++) k += city_codes[i] == c;
+    } else if (activity) {
+        const Code a = *activity;
+        for (size_t i = 0; i < n; i++) k += activity_codes[i] == a;
+    } else {
+        k = n;
+    }
+    return k;
+}
+
+size_t IntegratorStore::memory_bytes() const {
+    size_t b = ids.capacity() * sizeof(int32_t) + name_off.capacity() * sizeof(uint32_t) +
+               names.capacity() + city_codes.capacity() * sizeof(Code) +
+               activity_codes.capacity() * sizeof(Code);
+    for (auto& s : cities) b += sizeof(std::string) + s.capacity();
+    for (auto& s : activities) b += sizeof(std::string) + s.capacity();
+    return b;
+}
@@ -1,15 +1,115 @@
 #include "db.h"
+#include "sqlite_storage.h"
+#include "memory_storage.h"
 #include "console.h"
 #include "http_server.h"
 #include <thread>
 #include <iostream>
+#include <cstdlib>
+#include <csignal>
+#include <pthread.h>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+// Числовой параметр из окружения (для подбора размера пула без пересборки)
+static size_t env_size(const char* name, size_t def) {
+    const char* v = std::getenv(name);
+    return v ? std::strtoul(v, nullptr, 10) : def;
+}
+
+// PostgreSQL со всеми настройками из окружения; SIGHUP перечитывает queries.sql
+static std::unique_ptr<Database> open_postgres(const KdfConfig& kdf) {
+    // Все запросы читаются до подключения: без queries.sql или ключа в нём — отказ запуска
+    SqlLoader::load();
+
+    // SIGHUP перечитывает queries.sql. Сигнал блокируется до запуска потоков
+    // (они наследуют маску) и принимается sigwait в отдельном потоке
+    sigset_t hup;
+    sigemptyset(&hup);
+    sigaddset(&hup, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &hup, nullptr);
+
+    // Размер пула согласован с пулом потоков httplib (по умолчанию >= 8 воркеров)
+    PoolConfig pool;
+    pool.min_size = env_size("DB_POOL_MIN", 4);
+    pool.max_size = env_size("DB_POOL_MAX", 16);
+    pool.checkout_timeout = std::chrono::milliseconds(env_size("DB_POOL_TIMEOUT_MS", 5000));
+    pool.async_connections = env_size("DB_ASYNC_CONNECTIONS", 4);
+
+    // Реплики для чтения: conninfo через ';', например
+    // DB_REPLICAS="host=replica1 dbname=integrator_db user=postgres;host=replica2 ..."
+    ReplicaConfig replicas;
+    if (const char* list = std::getenv("DB_REPLICAS")) {
+        std::string s = list;
+        for (size_t pos = 0; pos <= s.size();) {
+            size_t end = s.find(';', pos);
+            if (end == std::string::npos) end = s.size();
+            if (end > pos) replicas.conninfos.push_back(s.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+    replicas.max_lag = std::chrono::milliseconds(env_size("DB_REPLICA_MAX_LAG_MS", 5000));
+
+    std::unique_ptr<Database> db(new Database(
+      "host=localhost dbname=integrator_db user=postgres password=postgres",
+      pool,
+      kdf,
+      replicas
+    ));
+
+    db->init();
+    if (env_size("DB_MEMORY_REPLICA", 1)) db->enable_replica();
+
+    // DB_SLOW_MS=0 выключает журнал медленных запросов
+    if (size_t slow_ms = env_size("DB_SLOW_MS", 200)) {
+        SlowLogConfig slow;
+        slow.threshold = std::chrono::milliseconds(slow_ms);
+        if (const char* path = std::getenv("DB_SLOW_LOG")) slow.path = path;
+        db->enable_slow_log(slow);
+    }
+
+    Database* d = db.get();
+    std::thread([d, hup]() {
+        int sig;
+        while (sigwait(&hup, &sig) == 0) {
+            QueryReload r = d->reload_queries();
+            if (r.ok) std::cerr << "queries.sql reloaded, version " << r.version << std::endl;
+            else std::cerr << "queries.sql reload error: " << r.error << std::endl;
+        }
+    }).detach();
+    return db;
+}
 
 int main() {
-    Database db(
-      "host=localhost dbname=integrator_db user=postgres password=postgres"
-    );
+    // Стоимость PBKDF2 подбирается по бенчмарку в консоли (пункт 10)
+    KdfConfig kdf;
+    kdf.iterations = int(env_size("DB_KDF_ITERATIONS", 200000));
+    kdf.threads = env_size("DB_HASH_THREADS", 2);
+    // Логины, ждущие хеша, занимают не больше половины потоков httplib
+    size_t half = http_worker_count() / 2;
+    kdf.queue_limit = env_size("DB_HASH_QUEUE", half > kdf.threads ? half - kdf.threads : 0);
 
-    db.init();
+    // DB_BACKEND: postgres (по умолчанию), sqlite (файл DB_SQLITE_PATH) или memory
+    std::string backend = std::getenv("DB_BACKEND") ? std::getenv("DB_BACKEND") : "postgres";
+    std::unique_ptr<Storage> storage;
+    Database* pg = nullptr;     // пул, реплики, queries.sql и статистика есть только у PostgreSQL
+    if (backend == "postgres") {
+        auto d = open_postgres(kdf);
+        pg = d.get();
+        storage = std::move(d);
+    } else if (backend == "sqlite") {
+        SqliteConfig sqlite;
+        if (const char* path = std::getenv("DB_SQLITE_PATH")) sqlite.path = path;
+        sqlite.readers = std::max<size_t>(1, env_size("DB_SQLITE_READERS", 4));
+        storage.reset(new SqliteStorage(sqlite, kdf));
+        storage->init();
+    } else if (backend == "memory") {
+        storage.reset(new MemoryStorage(kdf));
+    } else {
+        throw std::runtime_error("unknown DB_BACKEND: " + backend);
+    }
+    Storage& db = *storage;
 
     if (!db.has_admin()) {
         std::string p;
@@ -18,10 +118,19 @@ int main() {
         db.set_admin_password(p);
     }
 
+    // DB_WRITE_BEHIND=1: /admin_add через очередь с групповым коммитом
+    std::unique_ptr<WriteBehind> writes;
+    if (env_size("DB_WRITE_BEHIND", 0)) {
+        WriteBehindConfig wb;
+        wb.max_batch = env_size("DB_WRITE_BATCH", 256);
+        wb.queue_limit = env_size("DB_WRITE_QUEUE", 10000);
+        writes.reset(new WriteBehind(db, wb));
+    }
+
     std::thread web([&](){
-        start_http_server(db);
+        start_http_server(db, writes.get(), pg);
     });
 
-    console_loop(db);
+    console_loop(db, pg);
     web.join();
 }
@@ -0,0 +1,193 @@
+#include "memory_storage.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+MemoryStorage::MemoryStorage(const KdfConfig& kdf_cfg)
+    : kdf_cfg(kdf_cfg), hashers(kdf_cfg.threads, kdf_cfg.queue_limit) {}
+
+std::shared_ptr<const IntegratorSet> MemoryStorage::current() {
+    {
+        std::shared_lock<std::shared_mutex> lk(m);
+        if (pending.empty()) return published;
+    }
+    std::unique_lock<std::shared_mutex> lk(m);
+    if (pending.empty()) return published;
+
+    size_t name_bytes = 0;
+    for (auto& r : pending) name_bytes += r.name.size();
+    auto tail = std::make_shared<IntegratorStore>();
+    tail->reserve(pending.size(), name_bytes);
+    for (auto& r : pending) tail->add(r.id, r.name, r.city, r.activity);
+    pending.clear();
+
+    std::vector<IntegratorSet::Part> parts = published->parts();
+    parts.push_back(std::move(tail));
+    // Части идут подряд по id, поэтому слияние — дописывание младшей за старшей
+    while (parts.size() >= 2 && parts[parts.size() - 2]->size() <= 2 * parts.back()->size()) {
+        const IntegratorStore& a = *parts[parts.size() - 2];
+        const IntegratorStore& b = *parts.back();
+        auto merged = std::make_shared<IntegratorStore>();
+        merged->reserve(a.size() + b.size(), a.name_bytes() + b.name_bytes());
+        for (const IntegratorStore* s : {&a, &b})
+            for (size_t i = 0; i < s->size(); i++) merged->add(s->id(i), s->name(i), s->city(i), s->activity(i));
+        parts.pop_back();
+        parts.back() = std::move(merged);
+    }
+    published = std::make_shared<IntegratorSet>(std::move(parts));
+    return published;
+}
+
+bool MemoryStorage::has_admin() {
+    std::shared_lock<std::shared_mutex> lk(m);
+    return !admin.empty();
+}
+
+void MemoryStorage::set_admin_password(const std::string& password) {
+    std::string h = hash_password(password, kdf_cfg.iterations);
+    std::unique_lock<std::shared_mutex> lk(m);
+    admin = std::move(h);
+}
+
+bool MemoryStorage::check_admin_password(const std::string& password) {
+    std::string stored;
+    {
+        std::shared_lock<std::shared_mutex> lk(m);
+        stored = admin;
+    }
+    if (stored.empty()) return false;
+
+    PasswordCheck c = check_password(hashers, password, stored, kdf_cfg.iterations);
+    if (!c.rehash.empty()) {
+        std::unique_lock<std::shared_mutex> lk(m);
+        if (admin == stored) admin = std::move(c.rehash);
+    }
+    return c.ok;
+}
+
+int MemoryStorage::city_locked(const std::string& name) {
+    auto it = city_ids.find(name);
+    if (it != city_ids.end()) return it->second;
+    int id = int(cities.size()) + 1;
+    cities.push_back({id, name});
+    city_ids.emplace(name, id);
+    return id;
+}
+
+int MemoryStorage::insert_locked(const std::string& name, const std::string& city, const std::string& activity) {
+    int id = ++last_id;
+    pending.push_back({id, name, city, activity});
+    return id;
+}
+
+int MemoryStorage::add_city(const std::string& name) {
+    std::unique_lock<std::shared_mutex> lk(m);
+    return city_locked(name);
+}
+
+std::vector<City> MemoryStorage::get_cities() {
+    std::shared_lock<std::shared_mutex> lk(m);
+    std::vector<City> v = cities;
+    lk.unlock();
+    std::sort(v.begin(), v.end(), [](const City& a, const City& b) { return a.name < b.name; });
+    return v;
+}
+
+int MemoryStorage::get_city_id(const std::string& name) {
+    std::shared_lock<std::shared_mutex> lk(m);
+    auto it = city_ids.find(name);
+    return it == city_ids.end() ? -1 : it->second;
+}
+
+void MemoryStorage::add_integrator(const std::string& name, int city_id, const std::string& activity) {
+    std::unique_lock<std::shared_mutex> lk(m);
+    if (city_id < 1 || city_id > int(cities.size())) {
+        std::cerr << "Insert error: no city with id " << city_id << std::endl;
+        return;
+    }
+    insert_locked(name, cities[city_id - 1].name, activity);
+}
+
+int MemoryStorage::add_integrator_with_city(const std::string& name, const std::string& city,
+                                            const std::string& activity, uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    std::unique_lock<std::shared_mutex> lk(m);
+    city_locked(city);
+    return insert_locked(name, city, activity);
+}
+
+IntegratorRows MemoryStorage::get_integrators(uint64_t) {
+    return set_rows(current());
+}
+
+IntegratorPage MemoryStorage::get_integrators_page(int after_id, int limit, const IntegratorFilter& filter,
+                                                  uint64_t) {
+    return set_page(current(), after_id, limit, filter);
+}
+
+long long MemoryStorage::count_integrators(const IntegratorFilter& filter, uint64_t) {
+    return current()->count(filter);
+}
+
+SearchPage MemoryStorage::search_integrators(const std::string& query, int limit, int offset, uint64_t) {
+    auto s = current();
+    // Сначала совпадения в названии, затем только в деятельности; внутри — по id
+    std::vector<uint32_t> by_name, by_activity;
+    s->visit([&](uint32_t i) {
+        IntegratorRef r = s->row(i);
+        if (r.name.find(query) != std::string_view::npos) by_name.push_back(i);
+        else if (r.activity.find(query) != std::string_view::npos) by_activity.push_back(i);
+        return true;
+    });
+
+    SearchPage page{IntegratorRows(), {}, -1};
+    std::vector<uint32_t> hits;
+    size_t total = by_name.size() + by_activity.size();
+    for (size_t k = size_t(offset); k < total && hits.size() < size_t(limit); k++) {
+        bool in_name = k < by_name.size();
+        hits.push_back(in_name ? by_name[k] : by_activity[k - by_name.size()]);
+        page.ranks.push_back(in_name ? 1.0f : 0.5f);
+    }
+    if (size_t(offset) + hits.size() < total) page.next_offset = offset + limit;
+    page.items = set_rows(std::move(s), std::move(hits));
+    return page;
+}
+
+std::vector<BatchRowResult> MemoryStorage::add_integrators_batch(const std::vector<NewIntegrator>& batch,
+                                                                 uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    std::vector<BatchRowResult> res;
+    res.reserve(batch.size());
+    std::unique_lock<std::shared_mutex> lk(m);
+    for (auto& r : batch) {
+        city_locked(r.city);
+        res.push_back({insert_locked(r.name, r.city, r.activity), ""});
+    }
+    return res;
+}
+
+ImportStats MemoryStorage::import_integrators_csv(const CsvSource& source, bool header, uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    ImportStats st{false, "", 0, 0};
+    std::vector<NewIntegrator> batch;
+    st.ok = parse_integrators_csv(source, header, batch, st.error);
+    if (st.ok) {
+        add_integrators_batch(batch);
+        st.rows = (long long)batch.size();
+    } else {
+        std::cerr << "Import error: " << st.error << std::endl;
+    }
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return st;
+}
+
+bool MemoryStorage::export_integrators_csv(const CsvSink& sink) {
+    return write_integrators_csv(*this, sink);
+}
+
+bool MemoryStorage::for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn, uint64_t) {
+    auto s = current();
+    s->visit([&](uint32_t i) { return fn(s->row(i)); });
+    return true;
+}
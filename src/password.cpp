@@ -0,0 +1,197 @@
+#include "password.h"
+#include "util.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <memory>
+
+static const char* PBKDF2_PREFIX = "pbkdf2-sha256";
+static const int SALT_LEN = 16;
+static const int HASH_LEN = 32;
+static const int MAX_ITERATIONS = 10000000;
+
+static std::string to_hex(const unsigned char* data, size_t len) {
+    static const char* hex = "0123456789abcdef";
+    std::string out;
+    out.reserve(len * 2);
+    for (size_t i = 0; i < len; i++) {
+        out += hex[data[i] >> 4];
+        out += hex[data[i] & 15];
+    }
+    return out;
+}
+
+static bool from_hex(const std::string& s, std::vector<unsigned char>& out) {
+    if (s.size() % 2) return false;
+    auto nibble = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    out.clear();
+    for (size_t i = 0; i < s.size(); i += 2) {
+        int hi = nibble(s[i]), lo = nibble(s[i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out.push_back((unsigned char)(hi << 4 | lo));
+    }
+    return true;
+}
+
+static std::vector<unsigned char> pbkdf2(const std::string& password,
+                                         const unsigned char* salt, size_t salt_len,
+                                         int iterations, size_t out_len) {
+    std::vector<unsigned char> out(out_len);
+    if (PKCS5_PBKDF2_HMAC(password.data(), int(password.size()), salt, int(salt_len),
+                          iterations, EVP_sha256(), int(out_len), out.data()) != 1)
+        throw std::runtime_error("PKCS5_PBKDF2_HMAC failed");
+    return out;
+}
+
+static bool equal(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+    return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// hex от size_t без ведущих нулей: не длиннее 16 символов, в отличие от 64 у SHA-256
+static bool is_simple_hash(const std::string& stored) {
+    if (stored.empty() || stored.size() > 2 * sizeof(size_t)) return false;
+    return stored.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+bool password_hash_supported(const std::string& stored) {
+    if (is_simple_hash(stored)) return true;
+    std::vector<unsigned char> bytes;
+    if (stored.find('$') == std::string::npos)
+        return from_hex(stored, bytes) && bytes.size() == SHA256_DIGEST_LENGTH;
+    return stored.compare(0, stored.find('$'), PBKDF2_PREFIX) == 0;
+}
+
+std::string hash_password(const std::string& password, int iterations) {
+    unsigned char salt[SALT_LEN];
+    if (RAND_bytes(salt, SALT_LEN) != 1) throw std::runtime_error("RAND_bytes failed");
+    auto h = pbkdf2(password, salt, SALT_LEN, iterations, HASH_LEN);
+    return std::string(PBKDF2_PREFIX) + "$" + std::to_string(iterations) + "$" +
+           to_hex(salt, SALT_LEN) + "$" + to_hex(h.data(), h.size());
+}
+
+bool verify_password(const std::string& password, const std::string& stored,
+                     int iterations, bool& needs_rehash) {
+    needs_rehash = false;
+
+    // Самый старый формат: simple_hash (std::hash с постоянной солью) — так записан
+    // пароль в поставляемом integrators.db
+    if (is_simple_hash(stored)) {
+        std::string actual = simple_hash(password);
+        bool ok = actual.size() == stored.size() &&
+                  CRYPTO_memcmp(actual.data(), stored.data(), stored.size()) == 0;
+        needs_rehash = ok;
+        return ok;
+    }
+
+    // Старый формат: hex SHA-256 без соли
+    if (stored.find('$') == std::string::npos) {
+        std::vector<unsigned char> expected;
+        if (!from_hex(stored, expected)) return false;
+        std::vector<unsigned char> actual(SHA256_DIGEST_LENGTH);
+        SHA256((const unsigned char*)password.data(), password.size(), actual.data());
+        bool ok = equal(actual, expected);
+        needs_rehash = ok;
+        return ok;
+    }
+
+    // pbkdf2-sha256$iter$salt$hash
+    size_t p1 = stored.find('$');
+    size_t p2 = stored.find('$', p1 + 1);
+    size_t p3 = p2 == std::string::npos ? p2 : stored.find('$', p2 + 1);
+    if (p3 == std::string::npos || stored.compare(0, p1, PBKDF2_PREFIX) != 0) return false;
+
+    long iter = std::strtol(stored.c_str() + p1 + 1, nullptr, 10);
+    if (iter <= 0 || iter > MAX_ITERATIONS) return false;
+
+    std::vector<unsigned char> salt, expected;
+    if (!from_hex(stored.substr(p2 + 1, p3 - p2 - 1), salt) ||
+        !from_hex(stored.substr(p3 + 1), expected) || expected.empty())
+        return false;
+
+    bool ok = equal(pbkdf2(password, salt.data(), salt.size(), int(iter), expected.size()), expected);
+    needs_rehash = ok && iter < iterations;
+    return ok;
+}
+
+HashWorkers::HashWorkers(size_t threads, size_t queue_limit) {
+    if (threads == 0) threads = 1;
+    limit = threads + queue_limit;
+    for (size_t i = 0; i < threads; i++)
+        this->threads.emplace_back([this]() { run(); });
+}
+
+HashWorkers::~HashWorkers() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+bool HashWorkers::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (stopping || in_flight >= limit) return false;
+        in_flight++;
+        jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+    return true;
+}
+
+void HashWorkers::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+        std::lock_guard<std::mutex> lk(m);
+        in_flight--;
+    }
+}
+
+PasswordCheck check_password(HashWorkers& workers, const std::string& password,
+                             const std::string& stored, int iterations) {
+    auto task = std::make_shared<std::packaged_task<PasswordCheck()>>([password, stored, iterations]() {
+        bool needs_rehash;
+        PasswordCheck c{verify_password(password, stored, iterations, needs_rehash), ""};
+        if (c.ok && needs_rehash) c.rehash = hash_password(password, iterations);
+        return c;
+    });
+    std::future<PasswordCheck> result = task->get_future();
+    if (!workers.submit([task]() { (*task)(); })) throw HashQueueFull();
+    return result.get();
+}
+
+std::vector<KdfBenchmark> benchmark_kdf(const std::vector<int>& iterations) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<KdfBenchmark> out;
+    for (int iter : iterations) {
+        // Не меньше 3 хешей и ~0.5 с на каждую стоимость
+        int n = 0;
+        auto t0 = Clock::now();
+        double sec = 0;
+        while (n < 3 || sec < 0.5) {
+            hash_password("benchmark-password", iter);
+            n++;
+            sec = std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+        out.push_back({iter, n / sec, sec * 1000 / n});
+    }
+    return out;
+}
@@ -0,0 +1,209 @@
+#include "pool.h"
+#include <stdexcept>
+#include <thread>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t to_ns(Clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+PooledConn::PooledConn(ConnectionPool* pool, PgConn* conn)
+    : pool(pool), conn(conn), taken(Clock::now()) {}
+
+PooledConn::PooledConn(PooledConn&& other) noexcept
+    : pool(other.pool), conn(other.conn), taken(other.taken) {
+    other.conn = nullptr;
+}
+
+PooledConn::~PooledConn() {
+    if (conn) pool->release(conn, Clock::now() - taken);
+}
+
+ConnectionPool::ConnectionPool(const std::string& conninfo, const PoolConfig& cfg)
+    : conninfo(conninfo), cfg(cfg), started(Clock::now()) {
+    if (this->cfg.max_size == 0) this->cfg.max_size = 1;
+    if (this->cfg.min_size > this->cfg.max_size) this->cfg.min_size = this->cfg.max_size;
+
+    // Стартовые соединения открываем параллельно: время запуска ~ одному handshake
+    std::vector<PGconn*> conns(this->cfg.min_size, nullptr);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < conns.size(); i++) {
+        threads.emplace_back([this, &conns, i]() {
+            conns[i] = PQconnectdb(this->conninfo.c_str());
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    std::string error;
+    for (PGconn* c : conns) {
+        if (PQstatus(c) != CONNECTION_OK && error.empty())
+            error = PQerrorMessage(c);
+    }
+    if (!error.empty()) {
+        for (PGconn* c : conns) PQfinish(c);
+        throw std::runtime_error(error);
+    }
+
+    auto now = Clock::now();
+    for (PGconn* c : conns) idle.push_back(std::unique_ptr<PgConn>(new PgConn{c, {}, now}));
+    total = conns.size();
+    counters.size = total;
+}
+
+ConnectionPool::~ConnectionPool() {
+    std::lock_guard<std::mutex> lk(m);
+    for (auto& e : idle) PQfinish(e->conn);
+    if (idle.size() != total)
+        std::cerr << "Pool: " << total - idle.size() << " connections still in use" << std::endl;
+}
+
+PGconn* ConnectionPool::connect() {
+    PGconn* c = PQconnectdb(conninfo.c_str());
+    if (PQstatus(c) != CONNECTION_OK) {
+        std::string error = PQerrorMessage(c);
+        PQfinish(c);
+        throw std::runtime_error(error);
+    }
+    return c;
+}
+
+void ConnectionPool::set_on_connect(std::function<void(PgConn&)> fn) {
+    std::lock_guard<std::mutex> lk(m);
+    on_connect = std::move(fn);
+    // Уже открытые соединения пройдут хук при следующей выдаче
+    for (auto& e : idle) e->setup_done = false;
+}
+
+// После PQreset серверное состояние сессии (в т.ч. подготовленные запросы) потеряно
+void ConnectionPool::reset(PgConn& e) {
+    PQreset(e.conn);
+    e.prepared.reset();
+    e.setup_done = false;
+    std::lock_guard<std::mutex> lk(m);
+    counters.resets++;
+}
+
+// Проверка соединения перед выдачей. Сломанное пытаемся восстановить PQreset.
+bool ConnectionPool::ensure_healthy(PgConn& e) {
+    bool ok = PQstatus(e.conn) == CONNECTION_OK;
+    if (ok && Clock::now() - e.last_used > cfg.idle_check) {
+        PGresult* r = PQexec(e.conn, "SELECT 1");
+        ok = PQresultStatus(r) == PGRES_TUPLES_OK;
+        PQclear(r);
+    }
+    if (!ok) {
+        reset(e);
+        if (PQstatus(e.conn) != CONNECTION_OK) {
+            std::cerr << "Pool: reset failed: " << PQerrorMessage(e.conn) << std::endl;
+            PQfinish(e.conn);
+            return false;
+        }
+    }
+
+    if (!e.setup_done) {
+        std::function<void(PgConn&)> hook;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            hook = on_connect;
+        }
+        if (hook) hook(e);
+        e.setup_done = true;
+    }
+    return true;
+}
+
+PooledConn ConnectionPool::acquire() {
+    auto start = Clock::now();
+    auto deadline = start + cfg.checkout_timeout;
+    bool waited = false;
+
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        std::unique_ptr<PgConn> e;
+        bool create = false;
+
+        if (!idle.empty()) {
+            e = std::move(idle.back());
+            idle.pop_back();
+        } else if (total < cfg.max_size) {
+            total++;
+            counters.size = total;
+            create = true;
+        } else {
+            waited = true;
+            if (cv.wait_until(lk, deadline) == std::cv_status::timeout &&
+                idle.empty() && total >= cfg.max_size) {
+                counters.timeouts++;
+                throw std::runtime_error("connection pool: checkout timeout");
+            }
+            continue;
+        }
+
+        // Подключение и проверка идут без блокировки пула
+        lk.unlock();
+        if (create) {
+            try {
+                e.reset(new PgConn{connect(), {}, Clock::now()});
+            } catch (...) {
+                lk.lock();
+                total--;
+                counters.size = total;
+                cv.notify_one();
+                throw;
+            }
+        }
+        bool ok = ensure_healthy(*e);
+        lk.lock();
+
+        if (!ok) {
+            total--;
+            counters.size = total;
+            continue;
+        }
+
+        uint64_t wait_ns = to_ns(Clock::now() - start);
+        counters.checkouts++;
+        counters.in_use++;
+        if (counters.in_use > counters.peak_in_use) counters.peak_in_use = counters.in_use;
+        if (waited) {
+            counters.waits++;
+            counters.wait_ns_total += wait_ns;
+            if (wait_ns > counters.wait_ns_max) counters.wait_ns_max = wait_ns;
+        }
+        return PooledConn(this, e.release());
+    }
+}
+
+void ConnectionPool::release(PgConn* conn, Clock::duration held) {
+    // Соединение должно вернуться в пул без открытой транзакции и недочитанных результатов
+    switch (PQtransactionStatus(conn->conn)) {
+        case PQTRANS_IDLE:
+            break;
+        case PQTRANS_INTRANS:
+        case PQTRANS_INERROR: {
+            PGresult* r = PQexec(conn->conn, "ROLLBACK");
+            PQclear(r);
+            break;
+        }
+        default:
+            reset(*conn);
+    }
+
+    conn->last_used = Clock::now();
+    std::lock_guard<std::mutex> lk(m);
+    idle.push_back(std::unique_ptr<PgConn>(conn));
+    counters.in_use--;
+    counters.busy_ns_total += to_ns(held);
+    cv.notify_one();
+}
+
+PoolStats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lk(m);
+    PoolStats s = counters;
+    s.size = total;
+    s.max_size = cfg.max_size;
+    s.uptime_s = std::chrono::duration<double>(Clock::now() - started).count();
+    return s;
+}
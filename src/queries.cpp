@@ -0,0 +1,91 @@
+#include "queries.h"
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+static const char* const NAMES[] = {
+#define X(key) #key,
+    SQL_QUERIES(X)
+#undef X
+};
+
+const char* SqlLoader::name(Query q) {
+    return NAMES[int(q)];
+}
+
+bool SqlLoader::preparable(Query q) {
+    std::string_view n = NAMES[int(q)];
+    for (std::string_view prefix : {"CREATE_", "ALTER_", "COPY_", "TX_"})
+        if (n.substr(0, prefix.size()) == prefix) return false;
+    return true;
+}
+
+std::atomic<const SqlLoader::Table*> SqlLoader::current{nullptr};
+static std::mutex publish_mutex;
+
+// Под publish_mutex: заменённые таблицы и момент замены. Строку из get используют
+// только на время одного вызова libpq или копирования, так что через RETIRE_GRACE
+// таблицу уже никто не читает. Список растёт лишь на число перезагрузок за это время.
+static const std::chrono::seconds RETIRE_GRACE{60};
+struct RetiredTable {
+    std::unique_ptr<const SqlLoader::Table> table;
+    std::chrono::steady_clock::time_point since;
+};
+static std::deque<RetiredTable> retired;
+
+const SqlLoader::Table& SqlLoader::load_once() {
+    std::lock_guard<std::mutex> lk(publish_mutex);
+    if (const Table* t = current.load(std::memory_order_acquire)) return *t;
+    std::unique_ptr<Table> t = read();
+    t->version = 1;
+    current.store(t.get(), std::memory_order_release);
+    return *t.release();
+}
+
+uint64_t SqlLoader::publish(std::unique_ptr<Table> t) {
+    std::lock_guard<std::mutex> lk(publish_mutex);
+    const Table* prev = current.load(std::memory_order_acquire);
+    t->version = prev ? prev->version + 1 : 1;
+    uint64_t v = t->version;
+    current.store(t.release(), std::memory_order_release);
+
+    // Прежнюю таблицу ещё могут читать другие потоки — она освобождается позже
+    auto now = std::chrono::steady_clock::now();
+    while (!retired.empty() && now - retired.front().since >= RETIRE_GRACE) retired.pop_front();
+    if (prev) retired.push_back({std::unique_ptr<const Table>(prev), now});
+    return v;
+}
+
+std::unique_ptr<SqlLoader::Table> SqlLoader::read(const char* path) {
+    std::ifstream file(path);
+    if (!file) throw std::runtime_error(std::string(path) + " not found");
+
+    std::map<std::string, std::string> parsed;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '-') continue;
+        size_t pos = line.find('=');
+        if (pos != std::string::npos) parsed[line.substr(0, pos)] = line.substr(pos + 1);
+    }
+
+    std::unique_ptr<Table> t(new Table());
+    std::string missing;
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        auto it = parsed.find(NAMES[i]);
+        if (it == parsed.end()) {
+            missing += missing.empty() ? "" : ", ";
+            missing += NAMES[i];
+            continue;
+        }
+        t->sql[i] = std::move(it->second);
+        parsed.erase(it);
+    }
+    if (!missing.empty()) throw std::runtime_error(std::string(path) + ": missing " + missing);
+    for (auto& extra : parsed)
+        std::cerr << path << ": unknown key " << extra.first << std::endl;
+    return t;
+}
@@ -0,0 +1,88 @@
+#include "query_stats.h"
+#include <cstdlib>
+
+int LatencyHistogram::index(uint64_t us) {
+    if (us < uint64_t(2 * SUB)) return int(us);
+    int e = 63 - __builtin_clzll(us);            // старший бит, >= SUB_BITS + 1
+    int sub = int(us >> (e - SUB_BITS)) & (SUB - 1);
+    int i = 2 * SUB + (e - SUB_BITS - 1) * SUB + sub;
+    return i < BUCKETS ? i : BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::upper_bound(int index) {
+    if (index < 2 * SUB) return uint64_t(index);
+    int e = (index - 2 * SUB) / SUB + SUB_BITS + 1;
+    int sub = (index - 2 * SUB) % SUB;
+    return ((uint64_t(SUB + sub + 1)) << (e - SUB_BITS)) - 1;
+}
+
+std::vector<uint64_t> LatencyHistogram::counts_snapshot() const {
+    std::vector<uint64_t> out(BUCKETS);
+    for (int i = 0; i < BUCKETS; i++) out[i] = counts[i].load(std::memory_order_relaxed);
+    return out;
+}
+
+uint64_t LatencyHistogram::quantile(const std::vector<uint64_t>& counts, double q) {
+    uint64_t total = 0;
+    for (uint64_t c : counts) total += c;
+    if (total == 0) return 0;
+    uint64_t target = uint64_t(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= target) return upper_bound(int(i));
+    }
+    return upper_bound(int(counts.size()) - 1);
+}
+
+void QueryStats::record(Query key, Duration d, uint64_t rows, uint64_t bytes, bool error) {
+    Metrics& m = metrics[int(key)];
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    m.count.fetch_add(1, std::memory_order_relaxed);
+    if (error) m.errors.fetch_add(1, std::memory_order_relaxed);
+    m.rows.fetch_add(rows, std::memory_order_relaxed);
+    m.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    m.total_us.fetch_add(us, std::memory_order_relaxed);
+    uint64_t prev = m.max_us.load(std::memory_order_relaxed);
+    while (us > prev && !m.max_us.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    m.latency.record(us);
+}
+
+void QueryStats::record(Query key, Duration d, const PGresult* r) {
+    ExecStatusType st = r ? PQresultStatus(r) : PGRES_FATAL_ERROR;
+    bool error = st != PGRES_COMMAND_OK && st != PGRES_TUPLES_OK &&
+                 st != PGRES_COPY_IN && st != PGRES_COPY_OUT;
+    uint64_t rows = 0, bytes = 0;
+    if (st == PGRES_TUPLES_OK) {
+        int n = PQntuples(r), f = PQnfields(r);
+        rows = n;
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < f; j++) bytes += PQgetlength(r, i, j);
+    } else if (st == PGRES_COMMAND_OK) {
+        rows = std::strtoull(PQcmdTuples(const_cast<PGresult*>(r)), nullptr, 10);
+    }
+    record(key, d, rows, bytes, error);
+}
+
+std::vector<QueryStatsRow> QueryStats::snapshot() const {
+    std::vector<QueryStatsRow> out;
+    for (size_t i = 0; i < QUERY_COUNT; i++) {
+        const Metrics& m = metrics[i];
+        uint64_t count = m.count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        auto counts = m.latency.counts_snapshot();
+        out.push_back({
+            Query(i),
+            count,
+            m.errors.load(std::memory_order_relaxed),
+            m.rows.load(std::memory_order_relaxed),
+            m.bytes.load(std::memory_order_relaxed),
+            m.total_us.load(std::memory_order_relaxed) / 1e3 / count,
+            LatencyHistogram::quantile(counts, 0.50) / 1e3,
+            LatencyHistogram::quantile(counts, 0.95) / 1e3,
+            LatencyHistogram::quantile(counts, 0.99) / 1e3,
+            m.max_us.load(std::memory_order_relaxed) / 1e3,
+        });
+    }
+    return out;
+}
@@ -0,0 +1,113 @@
+#include "read_replicas.h"
+#include <cstdlib>
+#include <iostream>
+
+uint64_t parse_lsn(const char* s) {
+    if (!s || !*s) return 0;
+    char* end;
+    uint64_t hi = std::strtoull(s, &end, 16);
+    if (*end != '/') return 0;
+    uint64_t lo = std::strtoull(end + 1, nullptr, 16);
+    return hi << 32 | lo;
+}
+
+ReadReplicas::ReadReplicas(const std::string& primary_conninfo, const ReplicaConfig& cfg,
+                           std::function<void(PgConn&)> on_connect)
+    : primary_conninfo(primary_conninfo), cfg(cfg) {
+    // Соединения к репликам открываются по требованию: недоступная реплика не мешает запуску
+    PoolConfig pc;
+    pc.min_size = 0;
+    pc.max_size = cfg.pool_size;
+    for (auto& ci : cfg.conninfos) {
+        std::unique_ptr<Node> n(new Node());
+        n->conninfo = ci;
+        n->pool.reset(new ConnectionPool(ci, pc));
+        n->pool->set_on_connect(on_connect);
+        nodes.push_back(std::move(n));
+    }
+
+    // Первая проверка до возврата: чтения сразу получают реплики
+    uint64_t primary_lsn = 0;
+    primary_probe = PQconnectdb(primary_conninfo.c_str());
+    PGresult* r = PQexec(primary_probe, SqlLoader::get(Query::PRIMARY_WAL_LSN));
+    if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) primary_lsn = parse_lsn(PQgetvalue(r, 0, 0));
+    PQclear(r);
+    for (auto& n : nodes) check(*n, primary_lsn);
+
+    checker = std::thread([this]() { run(); });
+}
+
+ReadReplicas::~ReadReplicas() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    checker.join();
+    PQfinish(primary_probe);
+    for (auto& n : nodes) PQfinish(n->probe);
+}
+
+ConnectionPool* ReadReplicas::pick(uint64_t min_lsn) {
+    size_t count = nodes.size();
+    size_t start = next++;
+    for (size_t i = 0; i < count; i++) {
+        Node& n = *nodes[(start + i) % count];
+        if (n.healthy && n.replay_lsn >= min_lsn) return n.pool.get();
+    }
+    return nullptr;
+}
+
+void ReadReplicas::mark_down(ConnectionPool* pool) {
+    for (auto& n : nodes)
+        if (n->pool.get() == pool) n->healthy = false;
+}
+
+std::vector<ReplicaStatus> ReadReplicas::status() const {
+    std::vector<ReplicaStatus> out;
+    for (auto& n : nodes)
+        out.push_back({n->conninfo, n->healthy, n->replay_lsn, n->lag_ms, n->lag_bytes});
+    return out;
+}
+
+void ReadReplicas::check(Node& n, uint64_t primary_lsn) {
+    if (!n.probe || PQstatus(n.probe) != CONNECTION_OK) {
+        PQfinish(n.probe);
+        n.probe = PQconnectdb(n.conninfo.c_str());
+        if (PQstatus(n.probe) != CONNECTION_OK) {
+            if (n.healthy) std::cerr << "Replica down: " << PQerrorMessage(n.probe) << std::endl;
+            n.healthy = false;
+            return;
+        }
+    }
+
+    PGresult* r = PQexec(n.probe, SqlLoader::get(Query::REPLICA_STATUS));
+    bool ok = PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0;
+    if (ok) {
+        uint64_t lsn = parse_lsn(PQgetvalue(r, 0, 0));
+        double lag = std::atof(PQgetvalue(r, 0, 1));
+        n.replay_lsn = lsn;
+        n.lag_ms = lag;
+        n.lag_bytes = primary_lsn > lsn ? primary_lsn - lsn : 0;
+        // Простаивающий primary: время последней транзакции растёт, но WAL применён весь
+        ok = lsn >= primary_lsn || lag <= cfg.max_lag.count();
+    } else {
+        std::cerr << "Replica check error: " << PQerrorMessage(n.probe) << std::endl;
+    }
+    PQclear(r);
+    n.healthy = ok;
+}
+
+void ReadReplicas::run() {
+    std::unique_lock<std::mutex> lk(m);
+    while (!cv.wait_for(lk, cfg.check_interval, [this]() { return stopping; })) {
+        lk.unlock();
+        if (PQstatus(primary_probe) != CONNECTION_OK) PQreset(primary_probe);
+        uint64_t primary_lsn = 0;
+        PGresult* r = PQexec(primary_probe, SqlLoader::get(Query::PRIMARY_WAL_LSN));
+        if (PQresultStatus(r) == PGRES_TUPLES_OK && PQntuples(r) > 0) primary_lsn = parse_lsn(PQgetvalue(r, 0, 0));
+        PQclear(r);
+        for (auto& n : nodes) check(*n, primary_lsn);
+        lk.lock();
+    }
+}
@@ -0,0 +1,196 @@
+#include "replica.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+Replica::Replica(const std::string& conninfo, Loader load)
+    : conninfo(conninfo), load(std::move(load)) {
+    if (pipe(wake_fd) != 0) throw std::runtime_error("pipe failed");
+    for (int fd : wake_fd) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // LISTEN до первой загрузки: изменения между ними не потеряются
+    if (!connect()) {
+        std::string error = conn ? PQerrorMessage(conn) : "connect failed";
+        PQfinish(conn);
+        close(wake_fd[0]);
+        close(wake_fd[1]);
+        throw std::runtime_error(error);
+    }
+    reload();
+    if (!current()) {
+        PQfinish(conn);
+        close(wake_fd[0]);
+        close(wake_fd[1]);
+        throw std::runtime_error("replica: initial load failed");
+    }
+
+    listener = std::thread([this]() { run(); });
+}
+
+Replica::~Replica() {
+    stopping = true;
+    char b = 0;
+    if (write(wake_fd[1], &b, 1) < 0) {}
+    listener.join();
+    PQfinish(conn);
+    close(wake_fd[0]);
+    close(wake_fd[1]);
+}
+
+bool Replica::connect() {
+    PQfinish(conn);
+    conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) return false;
+
+    std::string sql = std::string("LISTEN ") + CHANNEL;
+    PGresult* r = PQexec(conn, sql.c_str());
+    bool ok = PQresultStatus(r) == PGRES_COMMAND_OK;
+    PQclear(r);
+    return ok;
+}
+
+void Replica::reload() {
+    uint64_t ticket, start;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        ticket = requested;
+    }
+    {
+        // apply вызывается после коммита: записи с номером <= start уже видны загрузке
+        std::lock_guard<std::mutex> lk(publish_m);
+        start = apply_seq;
+    }
+    try {
+        std::shared_ptr<const Snapshot> next = load();
+        if (next) {
+            std::lock_guard<std::mutex> lk(publish_m);
+            while (!applied.empty() && applied.front().seq <= start) applied.pop_front();
+            // Переносятся только свои записи, сделанные после начала загрузки;
+            // остальное (и удалённое другими экземплярами) берётся из next
+            std::vector<Integrator> rows;
+            std::vector<City> cities;
+            for (auto& a : applied) {
+                rows.insert(rows.end(), a.rows.begin(), a.rows.end());
+                cities.insert(cities.end(), a.cities.begin(), a.cities.end());
+            }
+            publish(next, rows, cities);
+            reload_count++;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Replica reload error: " << e.what() << std::endl;
+    }
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (ticket > completed) completed = ticket;
+    }
+    cv.notify_all();
+}
+
+static bool has_id(const IntegratorStore& s, int id) {
+    size_t i = s.upper_bound(id);
+    return i > 0 && s.id(i - 1) == id;
+}
+
+void Replica::publish(std::shared_ptr<const Snapshot> base, const std::vector<Integrator>& rows,
+                      const std::vector<City>& cities) {
+    auto& parts = base->integrators.parts();
+    IntegratorSet::Part loaded = parts.empty() ? std::make_shared<IntegratorStore>() : parts[0];
+
+    // Вторая часть: прежняя (у снимка от apply) плюс строки, которых нет ни в одной части
+    auto delta = std::make_shared<IntegratorStore>();
+    if (parts.size() > 1) {
+        const IntegratorStore& d = *parts[1];
+        for (size_t i = 0; i < d.size(); i++) delta->add(d.id(i), d.name(i), d.city(i), d.activity(i));
+    }
+    bool changed = false;
+    for (auto& r : rows) {
+        if (has_id(*loaded, r.id) || (parts.size() > 1 && has_id(*parts[1], r.id))) continue;
+        delta->add(r.id, r.name, r.city, r.activity);
+        changed = true;
+    }
+
+    std::vector<City> merged = base->cities;
+    // Городов сотни, а порядок задан сортировкой БД — поиск перебором
+    for (auto& c : cities) {
+        auto same = [&](const City& x) { return x.name == c.name; };
+        if (std::find_if(merged.begin(), merged.end(), same) != merged.end()) continue;
+        auto after = [&](const City& x) { return x.name > c.name; };
+        merged.insert(std::find_if(merged.begin(), merged.end(), after), c);
+        changed = true;
+    }
+
+    if (!changed) {
+        std::atomic_store(&snap, base);
+        return;
+    }
+    delta->finish();
+    auto next = std::make_shared<Snapshot>();
+    next->cities = std::move(merged);
+    next->integrators = delta->empty() ? IntegratorSet({loaded}) : IntegratorSet({loaded, delta});
+    std::atomic_store(&snap, std::shared_ptr<const Snapshot>(std::move(next)));
+}
+
+void Replica::apply(const std::vector<Integrator>& rows, const std::vector<City>& cities) {
+    std::lock_guard<std::mutex> lk(publish_m);
+    applied.push_back({++apply_seq, rows, cities});
+    if (auto cur = current()) publish(cur, rows, cities);
+}
+
+bool Replica::sync(std::chrono::milliseconds timeout) {
+    uint64_t ticket;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        ticket = ++requested;
+    }
+    char b = 0;
+    if (write(wake_fd[1], &b, 1) < 0) {}
+
+    std::unique_lock<std::mutex> lk(m);
+    if (cv.wait_for(lk, timeout, [&]() { return completed >= ticket; })) return true;
+    std::cerr << "Replica sync timeout after " << timeout.count() << " ms: snapshot may lag behind the write"
+              << std::endl;
+    return false;
+}
+
+void Replica::run() {
+    while (!stopping) {
+        if (PQstatus(conn) != CONNECTION_OK) {
+            if (!connect()) {
+                std::cerr << "Replica listen error: " << PQerrorMessage(conn) << std::endl;
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+                continue;
+            }
+            // Пока соединения не было, уведомления могли потеряться
+            reload();
+        }
+
+        pollfd fds[2] = {
+            {PQsocket(conn), POLLIN, 0},
+            {wake_fd[0], POLLIN, 0},
+        };
+        if (poll(fds, 2, 1000) <= 0) continue;
+
+        bool changed = false;
+        if (fds[1].revents) {
+            char buf[64];
+            while (read(wake_fd[0], buf, sizeof(buf)) > 0) {}
+            changed = true;
+        }
+        if (fds[0].revents) {
+            if (!PQconsumeInput(conn)) {
+                PQfinish(conn);
+                conn = nullptr;
+                continue;
+            }
+            // Пачка уведомлений (например, от пакетной вставки) — одна перезагрузка
+            while (PGnotify* n = PQnotifies(conn)) {
+                changed = true;
+                PQfreemem(n);
+            }
+        }
+        if (changed && !stopping) reload();
+    }
+}
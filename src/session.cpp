@@ -0,0 +1,71 @@
+#include "session.h"
+#include <openssl/rand.h>
+#include <stdexcept>
+
+SessionStore::SessionStore(std::chrono::seconds ttl) : ttl(ttl) {}
+
+std::string SessionStore::create() {
+    unsigned char bytes[32];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1)
+        throw std::runtime_error("RAND_bytes failed");
+
+    static const char* hex = "0123456789abcdef";
+    std::string token;
+    for (unsigned char b : bytes) {
+        token += hex[b >> 4];
+        token += hex[b & 15];
+    }
+
+    auto now = Clock::now();
+    Shard& s = shard(token);
+    std::lock_guard<std::mutex> lk(s.m);
+    for (auto it = s.sessions.begin(); it != s.sessions.end();) {
+        if (it->second.expires <= now) it = s.sessions.erase(it);
+        else ++it;
+    }
+    s.sessions[token] = {now + ttl, 0};
+    return token;
+}
+
+bool SessionStore::validate(const std::string& token) {
+    if (token.empty()) return false;
+    Shard& s = shard(token);
+    std::lock_guard<std::mutex> lk(s.m);
+    auto it = s.sessions.find(token);
+    if (it == s.sessions.end()) return false;
+    if (it->second.expires <= Clock::now()) {
+        s.sessions.erase(it);
+        return false;
+    }
+    return true;
+}
+
+void SessionStore::remove(const std::string& token) {
+    Shard& s = shard(token);
+    std::lock_guard<std::mutex> lk(s.m);
+    s.sessions.erase(token);
+}
+
+void SessionStore::note_write(const std::string& token, uint64_t lsn) {
+    Shard& s = shard(token);
+    std::lock_guard<std::mutex> lk(s.m);
+    auto it = s.sessions.find(token);
+    if (it != s.sessions.end() && lsn > it->second.write_lsn) it->second.write_lsn = lsn;
+}
+
+uint64_t SessionStore::write_lsn(const std::string& token) {
+    if (token.empty()) return 0;
+    Shard& s = shard(token);
+    std::lock_guard<std::mutex> lk(s.m);
+    auto it = s.sessions.find(token);
+    return it != s.sessions.end() ? it->second.write_lsn : 0;
+}
+
+size_t SessionStore::size() const {
+    size_t n = 0;
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lk(s.m);
+        n += s.sessions.size();
+    }
+    return n;
+}
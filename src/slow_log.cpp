@@ -0,0 +1,152 @@
+#include "slow_log.h"
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+
+// Параметры с хешем пароля администратора в журнал не попадают, и EXPLAIN для них не снимается
+static bool sensitive(Query key) {
+    return key == Query::INSERT_ADMIN || key == Query::UPDATE_ADMIN_HASH;
+}
+
+static const size_t MAX_PARAM_LEN = 200;
+
+SlowQueryLog::SlowQueryLog(const std::string& conninfo, const SlowLogConfig& cfg)
+    : conninfo(conninfo), cfg(cfg) {
+    out.open(cfg.path, std::ios::app);
+    if (!out) throw std::runtime_error("cannot open " + cfg.path);
+    out.seekp(0, std::ios::end);
+    written = size_t(out.tellp());
+    writer = std::thread([this]() { run(); });
+}
+
+SlowQueryLog::~SlowQueryLog() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    writer.join();
+    PQfinish(side);
+}
+
+void SlowQueryLog::submit(Query key, int n_params, const char* const* values,
+                          std::chrono::steady_clock::duration took, long long rows) {
+    Entry e{key, {}, std::chrono::duration<double, std::milli>(took).count(), rows,
+            std::chrono::system_clock::now(), false};
+    for (int i = 0; i < n_params; i++) {
+        if (sensitive(key)) e.params.push_back("<redacted>");
+        else if (!values[i]) e.params.push_back(std::nullopt);
+        else e.params.push_back(std::string(values[i]));
+    }
+
+    // Первый медленный запрос ключа за интервал получает EXPLAIN
+    if (SqlLoader::preparable(key) && !sensitive(key)) {
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count() | 1;
+        int64_t interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(cfg.explain_interval).count();
+        std::atomic<int64_t>& last = last_explain[int(key)];
+        int64_t prev = last.load(std::memory_order_relaxed);
+        e.explain = (prev == 0 || now - prev >= interval) &&
+                    last.compare_exchange_strong(prev, now, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (queue.size() >= cfg.queue_limit) {
+            drop_count++;
+            return;
+        }
+        queue.push_back(std::move(e));
+    }
+    cv.notify_one();
+}
+
+void SlowQueryLog::run() {
+    std::unique_lock<std::mutex> lk(m);
+    while (true) {
+        cv.wait(lk, [this]() { return stopping || !queue.empty(); });
+        if (queue.empty()) return;
+        Entry e = std::move(queue.front());
+        queue.pop_front();
+        lk.unlock();
+        write(e);
+        lk.lock();
+    }
+}
+
+std::string SlowQueryLog::explain(const Entry& e) {
+    if (!side || PQstatus(side) != CONNECTION_OK) {
+        PQfinish(side);
+        side = PQconnectdb(conninfo.c_str());
+        if (PQstatus(side) != CONNECTION_OK) return std::string("  explain: ") + PQerrorMessage(side);
+    }
+
+    std::vector<const char*> values;
+    for (auto& p : e.params) values.push_back(p ? p->c_str() : NULL);
+    std::string sql = std::string("EXPLAIN (ANALYZE, BUFFERS) ") + SqlLoader::get(e.key);
+
+    PQclear(PQexec(side, "BEGIN"));
+    PGresult* r = PQexecParams(side, sql.c_str(), int(values.size()), NULL, values.data(), NULL, NULL, 0);
+    std::string plan;
+    if (PQresultStatus(r) == PGRES_TUPLES_OK) {
+        for (int i = 0; i < PQntuples(r); i++) {
+            plan += "  ";
+            plan += PQgetvalue(r, i, 0);
+            plan += "\n";
+        }
+    } else {
+        plan = std::string("  explain: ") + PQresultErrorMessage(r);
+    }
+    PQclear(r);
+    PQclear(PQexec(side, "ROLLBACK"));
+    return plan;
+}
+
+void SlowQueryLog::write(const Entry& e) {
+    char ts[32];
+    std::time_t t = std::chrono::system_clock::to_time_t(e.at);
+    std::tm tm;
+    localtime_r(&t, &tm);
+    std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    char head[256];
+    std::snprintf(head, sizeof(head), "%s key=%s duration_ms=%.3f rows=%lld params=[",
+                  ts, SqlLoader::name(e.key), e.ms, e.rows);
+    std::string line = head;
+    for (size_t i = 0; i < e.params.size(); i++) {
+        if (i) line += ", ";
+        if (!e.params[i]) {
+            line += "NULL";
+            continue;
+        }
+        std::string_view v = *e.params[i];
+        line += '"';
+        for (char c : v.substr(0, MAX_PARAM_LEN)) {
+            if (c == '\n') line += "\\n";
+            else if (c == '"' || c == '\\') { line += '\\'; line += c; }
+            else line += c;
+        }
+        if (v.size() > MAX_PARAM_LEN) line += "...";
+        line += '"';
+    }
+    line += "]\n";
+    if (e.explain) line += explain(e);
+
+    if (written + line.size() > cfg.max_bytes && written > 0) rotate();
+    out << line;
+    out.flush();
+    written += line.size();
+}
+
+// slow.log -> slow.log.1 -> ... -> slow.log.N (самый старый удаляется)
+void SlowQueryLog::rotate() {
+    out.close();
+    for (int i = cfg.keep_files; i >= 1; i--) {
+        std::string from = i == 1 ? cfg.path : cfg.path + "." + std::to_string(i - 1);
+        std::string to = cfg.path + "." + std::to_string(i);
+        std::rename(from.c_str(), to.c_str());
+    }
+    if (cfg.keep_files < 1) std::remove(cfg.path.c_str());
+    out.open(cfg.path, std::ios::trunc);
+    if (!out) std::cerr << "Slow log: cannot reopen " << cfg.path << std::endl;
+    written = 0;
+}
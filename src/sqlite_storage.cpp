@@ -0,0 +1,436 @@
+#include "sqlite_storage.h"
+#include <iostream>
+#include <stdexcept>
+
+static const char* const STMT_SQL[] = {
+    "BEGIN IMMEDIATE",
+    "COMMIT",
+    "ROLLBACK",
+    "INSERT OR IGNORE INTO cities(name) VALUES(?1)",
+    "SELECT id FROM cities WHERE name = ?1",
+    "SELECT name FROM cities WHERE id = ?1",
+    "SELECT id, name FROM cities ORDER BY name",
+    "INSERT INTO integrators(name, city, description) VALUES(?1, ?2, ?3)",
+    "SELECT id, name, city, description FROM integrators ORDER BY id",
+    "SELECT id, name, city, description FROM integrators WHERE id > ?1 ORDER BY id LIMIT ?2",
+    "SELECT id, name, city, description FROM integrators WHERE city = ?3 AND id > ?1 ORDER BY id LIMIT ?2",
+    "SELECT id, name, city, description FROM integrators WHERE description = ?4 AND id > ?1 ORDER BY id LIMIT ?2",
+    "SELECT id, name, city, description FROM integrators WHERE city = ?3 AND description = ?4 AND id > ?1 "
+    "ORDER BY id LIMIT ?2",
+    "SELECT count(*) FROM integrators WHERE (?1 IS NULL OR city = ?1) AND (?2 IS NULL OR description = ?2)",
+    "SELECT id, name, city, description, "
+    "CASE WHEN name LIKE ?1 ESCAPE '\\' THEN 1.0 ELSE 0.5 END AS rank FROM integrators "
+    "WHERE name LIKE ?1 ESCAPE '\\' OR description LIKE ?1 ESCAPE '\\' ORDER BY rank DESC, id LIMIT ?2 OFFSET ?3",
+    "SELECT value FROM kv WHERE key = 'admin_password_hash'",
+    "INSERT OR REPLACE INTO kv(key, value) VALUES('admin_password_hash', ?1)",
+    "UPDATE kv SET value = ?1 WHERE key = 'admin_password_hash' AND value = ?2",
+};
+
+// Схема integrators.db из репозитория; cities заполняется из уже записанных городов
+static const char* const SCHEMA[] = {
+    "CREATE TABLE IF NOT EXISTS kv (key TEXT PRIMARY KEY, value TEXT)",
+    "CREATE TABLE IF NOT EXISTS integrators (id INTEGER PRIMARY KEY AUTOINCREMENT, name TEXT, city TEXT, description TEXT)",
+    "CREATE TABLE IF NOT EXISTS cities (id INTEGER PRIMARY KEY, name TEXT UNIQUE NOT NULL)",
+    "INSERT OR IGNORE INTO cities(name) SELECT DISTINCT city FROM integrators WHERE city IS NOT NULL",
+    "CREATE INDEX IF NOT EXISTS integrators_city_idx ON integrators(city, id)",
+    "CREATE INDEX IF NOT EXISTS integrators_description_idx ON integrators(description, id)",
+};
+
+// Сброс оператора после использования: он остаётся подготовленным для следующего вызова
+struct StmtReset {
+    sqlite3_stmt* st;
+    ~StmtReset() {
+        sqlite3_reset(st);
+        sqlite3_clear_bindings(st);
+    }
+};
+
+// Строка живёт до конца шага оператора, копировать её не нужно
+static void bind_text(sqlite3_stmt* st, int i, std::string_view v) {
+    sqlite3_bind_text(st, i, v.data(), int(v.size()), SQLITE_STATIC);
+}
+
+static std::string_view column_text(sqlite3_stmt* st, int col) {
+    const char* p = reinterpret_cast<const char*>(sqlite3_column_text(st, col));
+    return p ? std::string_view(p, sqlite3_column_bytes(st, col)) : std::string_view();
+}
+
+// Оставшиеся строки результата формы (id, name, city, description) — в столбцовое хранилище
+static std::shared_ptr<IntegratorStore> read_store(sqlite3_stmt* st, bool& ok) {
+    auto store = std::make_shared<IntegratorStore>();
+    int rc;
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW)
+        store->add(sqlite3_column_int(st, 0), column_text(st, 1), column_text(st, 2), column_text(st, 3));
+    ok = rc == SQLITE_DONE;
+    store->finish();
+    return store;
+}
+
+SqliteStorage::SqliteStorage(const SqliteConfig& cfg, const KdfConfig& kdf_cfg)
+    : cfg(cfg), kdf_cfg(kdf_cfg), hashers(kdf_cfg.threads, kdf_cfg.queue_limit) {
+    writer = open(false);
+}
+
+SqliteStorage::~SqliteStorage() {
+    for (Conn* c : readers) close(c);
+    close(writer);
+}
+
+SqliteStorage::Conn* SqliteStorage::open(bool read_only) {
+    Conn* c = new Conn;
+    // Соединение используется одним потоком за раз — мьютексы SQLite не нужны
+    int rc = sqlite3_open_v2(cfg.path.c_str(), &c->db,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        std::string error = c->db ? sqlite3_errmsg(c->db) : sqlite3_errstr(rc);
+        close(c);
+        throw std::runtime_error("sqlite open " + cfg.path + ": " + error);
+    }
+    sqlite3_busy_timeout(c->db, int(cfg.busy_timeout.count()));
+    // WAL: читатели не ждут писателя; synchronous=NORMAL в WAL не теряет целостность
+    const char* pragmas = read_only ? "PRAGMA query_only = 1"
+                                    : "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL";
+    char* err = nullptr;
+    if (sqlite3_exec(c->db, pragmas, nullptr, nullptr, &err) != SQLITE_OK) {
+        std::string error = err ? err : "pragma failed";
+        sqlite3_free(err);
+        close(c);
+        throw std::runtime_error("sqlite " + cfg.path + ": " + error);
+    }
+    return c;
+}
+
+void SqliteStorage::close(Conn* c) {
+    if (!c) return;
+    for (sqlite3_stmt* st : c->stmts) sqlite3_finalize(st);
+    sqlite3_close(c->db);
+    delete c;
+}
+
+sqlite3_stmt* SqliteStorage::stmt(Conn& c, Stmt s) {
+    static_assert(sizeof(STMT_SQL) / sizeof(STMT_SQL[0]) == STMT_COUNT, "STMT_SQL must match Stmt");
+    if (!c.stmts[s]) {
+        if (sqlite3_prepare_v3(c.db, STMT_SQL[s], -1, SQLITE_PREPARE_PERSISTENT, &c.stmts[s], nullptr) != SQLITE_OK)
+            throw std::runtime_error(std::string("sqlite prepare: ") + sqlite3_errmsg(c.db));
+    }
+    return c.stmts[s];
+}
+
+bool SqliteStorage::exec(Conn& c, Stmt s) {
+    sqlite3_stmt* st = stmt(c, s);
+    StmtReset reset{st};
+    if (sqlite3_step(st) == SQLITE_DONE) return true;
+    std::cerr << "SQLite error: " << sqlite3_errmsg(c.db) << std::endl;
+    return false;
+}
+
+SqliteStorage::Reader::Reader(SqliteStorage& s) : s(s) {
+    std::unique_lock<std::mutex> lk(s.readers_mutex);
+    // Соединения открываются по мере надобности, до cfg.readers
+    if (s.idle_readers.empty() && s.readers.size() < s.cfg.readers) {
+        s.readers.push_back(s.open(true));
+        s.idle_readers.push_back(s.readers.back());
+    }
+    s.readers_cv.wait(lk, [&]() { return !s.idle_readers.empty(); });
+    c = s.idle_readers.back();
+    s.idle_readers.pop_back();
+}
+
+SqliteStorage::Reader::~Reader() {
+    {
+        std::lock_guard<std::mutex> lk(s.readers_mutex);
+        s.idle_readers.push_back(c);
+    }
+    s.readers_cv.notify_one();
+}
+
+void SqliteStorage::init() {
+    std::lock_guard<std::mutex> lk(write_mutex);
+    for (const char* ddl : SCHEMA) {
+        char* err = nullptr;
+        if (sqlite3_exec(writer->db, ddl, nullptr, nullptr, &err) != SQLITE_OK) {
+            std::string error = err ? err : "unknown error";
+            sqlite3_free(err);
+            throw std::runtime_error("sqlite schema: " + error);
+        }
+    }
+}
+
+std::string SqliteStorage::admin_hash() {
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, SELECT_ADMIN_HASH);
+    StmtReset reset{st};
+    return sqlite3_step(st) == SQLITE_ROW ? std::string(column_text(st, 0)) : std::string();
+}
+
+bool SqliteStorage::has_admin() {
+    // Хеш непонятного формата не проверить — main предложит задать пароль заново
+    return password_hash_supported(admin_hash());
+}
+
+void SqliteStorage::set_admin_password(const std::string& password) {
+    std::string h = hash_password(password, kdf_cfg.iterations);
+    std::lock_guard<std::mutex> lk(write_mutex);
+    sqlite3_stmt* st = stmt(*writer, SET_ADMIN_HASH);
+    StmtReset reset{st};
+    bind_text(st, 1, h);
+    if (sqlite3_step(st) != SQLITE_DONE)
+        std::cerr << "SQLite error: " << sqlite3_errmsg(writer->db) << std::endl;
+}
+
+bool SqliteStorage::check_admin_password(const std::string& password) {
+    std::string stored = admin_hash();
+    if (stored.empty()) return false;
+
+    PasswordCheck c = check_password(hashers, password, stored, kdf_cfg.iterations);
+    if (!c.rehash.empty()) {
+        std::lock_guard<std::mutex> lk(write_mutex);
+        sqlite3_stmt* st = stmt(*writer, UPDATE_ADMIN_HASH);
+        StmtReset reset{st};
+        bind_text(st, 1, c.rehash);
+        bind_text(st, 2, stored);
+        if (sqlite3_step(st) != SQLITE_DONE)
+            std::cerr << "SQLite rehash error: " << sqlite3_errmsg(writer->db) << std::endl;
+    }
+    return c.ok;
+}
+
+int SqliteStorage::city_id(Conn& c, const std::string& name) {
+    sqlite3_stmt* st = stmt(c, SELECT_CITY_BY_NAME);
+    StmtReset reset{st};
+    bind_text(st, 1, name);
+    return sqlite3_step(st) == SQLITE_ROW ? sqlite3_column_int(st, 0) : -1;
+}
+
+// Вызывается под write_mutex
+int SqliteStorage::insert_city(Conn& c, const std::string& name) {
+    {
+        sqlite3_stmt* st = stmt(c, INSERT_CITY);
+        StmtReset reset{st};
+        bind_text(st, 1, name);
+        if (sqlite3_step(st) != SQLITE_DONE) return -1;
+    }
+    return city_id(c, name);
+}
+
+int SqliteStorage::add_city(const std::string& name) {
+    std::lock_guard<std::mutex> lk(write_mutex);
+    int id = insert_city(*writer, name);
+    if (id < 0) std::cerr << "SQLite insert city error: " << sqlite3_errmsg(writer->db) << std::endl;
+    return id;
+}
+
+std::vector<City> SqliteStorage::get_cities() {
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, SELECT_CITIES);
+    StmtReset reset{st};
+    std::vector<City> v;
+    while (sqlite3_step(st) == SQLITE_ROW) v.push_back({sqlite3_column_int(st, 0), std::string(column_text(st, 1))});
+    return v;
+}
+
+int SqliteStorage::get_city_id(const std::string& name) {
+    Reader r(*this);
+    return city_id(*r, name);
+}
+
+void SqliteStorage::add_integrator(const std::string& name, int city_id, const std::string& activity) {
+    std::lock_guard<std::mutex> lk(write_mutex);
+    std::string city;
+    {
+        sqlite3_stmt* st = stmt(*writer, SELECT_CITY_NAME);
+        StmtReset reset{st};
+        sqlite3_bind_int(st, 1, city_id);
+        if (sqlite3_step(st) != SQLITE_ROW) {
+            std::cerr << "Insert error: no city with id " << city_id << std::endl;
+            return;
+        }
+        city = std::string(column_text(st, 0));
+    }
+    sqlite3_stmt* st = stmt(*writer, INSERT_INTEGRATOR);
+    StmtReset reset{st};
+    bind_text(st, 1, name);
+    bind_text(st, 2, city);
+    bind_text(st, 3, activity);
+    if (sqlite3_step(st) != SQLITE_DONE)
+        std::cerr << "SQLite insert error: " << sqlite3_errmsg(writer->db) << std::endl;
+}
+
+int SqliteStorage::add_integrator_with_city(const std::string& name, const std::string& city,
+                                            const std::string& activity, uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    std::string error;
+    auto res = insert_rows({{name, city, activity}}, error);
+    if (res[0].id < 0) std::cerr << "Insert error: " << res[0].error << std::endl;
+    return res[0].id;
+}
+
+// Город (если его нет) и строка интегратора для каждой строки в одной транзакции
+std::vector<BatchRowResult> SqliteStorage::insert_rows(const std::vector<NewIntegrator>& rows,
+                                                       std::string& first_error) {
+    const char* not_done = "не выполнено: транзакция отменена";
+    std::vector<BatchRowResult> res(rows.size(), BatchRowResult{-1, not_done});
+    if (rows.empty()) return res;
+
+    std::lock_guard<std::mutex> lk(write_mutex);
+    Conn& c = *writer;
+    if (!exec(c, BEGIN)) {
+        first_error = sqlite3_errmsg(c.db);
+        for (auto& x : res) x.error = first_error;
+        return res;
+    }
+
+    size_t failed_row = rows.size();
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (insert_city(c, rows[i].city) < 0) { failed_row = i; break; }
+        sqlite3_stmt* st = stmt(c, INSERT_INTEGRATOR);
+        StmtReset reset{st};
+        bind_text(st, 1, rows[i].name);
+        bind_text(st, 2, rows[i].city);
+        bind_text(st, 3, rows[i].activity);
+        if (sqlite3_step(st) != SQLITE_DONE) { failed_row = i; break; }
+        res[i] = {int(sqlite3_last_insert_rowid(c.db)), ""};
+    }
+
+    if (failed_row == rows.size() && exec(c, COMMIT)) return res;
+
+    first_error = sqlite3_errmsg(c.db);
+    exec(c, ROLLBACK);
+    for (auto& x : res) x = {-1, std::string(not_done) + " (" + first_error + ")"};
+    if (failed_row < rows.size()) res[failed_row].error = first_error;
+    return res;
+}
+
+IntegratorRows SqliteStorage::get_integrators(uint64_t) {
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, SELECT_INTEGRATORS);
+    StmtReset reset{st};
+    bool ok;
+    auto store = read_store(st, ok);
+    if (!ok) std::cerr << "SQLite select error: " << sqlite3_errmsg((*r).db) << std::endl;
+    return IntegratorRows(std::move(store));
+}
+
+IntegratorPage SqliteStorage::get_integrators_page(int after_id, int limit, const IntegratorFilter& filter,
+                                                  uint64_t) {
+    Stmt s = SELECT_PAGE;
+    if (!filter.city.empty() && !filter.activity.empty()) s = SELECT_PAGE_BY_CITY_ACTIVITY;
+    else if (!filter.city.empty()) s = SELECT_PAGE_BY_CITY;
+    else if (!filter.activity.empty()) s = SELECT_PAGE_BY_ACTIVITY;
+
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, s);
+    StmtReset reset{st};
+    // На одну строку больше, чтобы узнать, есть ли следующая страница
+    sqlite3_bind_int(st, 1, after_id);
+    sqlite3_bind_int(st, 2, limit + 1);
+    if (!filter.city.empty()) bind_text(st, 3, filter.city);
+    if (!filter.activity.empty()) bind_text(st, 4, filter.activity);
+    bool ok;
+    auto store = read_store(st, ok);
+    if (!ok) {
+        std::cerr << "SQLite select error: " << sqlite3_errmsg((*r).db) << std::endl;
+        return {IntegratorRows(), -1, false};
+    }
+
+    IntegratorPage page{IntegratorRows(std::move(store)), -1};
+    if (int(page.items.size()) > limit) {
+        page.items.truncate(limit);
+        page.next_after = page.items.back().id;
+    }
+    return page;
+}
+
+long long SqliteStorage::count_integrators(const IntegratorFilter& filter, uint64_t) {
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, COUNT_INTEGRATORS);
+    StmtReset reset{st};
+    if (!filter.city.empty()) bind_text(st, 1, filter.city);
+    if (!filter.activity.empty()) bind_text(st, 2, filter.activity);
+    if (sqlite3_step(st) != SQLITE_ROW) {
+        std::cerr << "SQLite count error: " << sqlite3_errmsg((*r).db) << std::endl;
+        return -1;
+    }
+    return sqlite3_column_int64(st, 0);
+}
+
+SearchPage SqliteStorage::search_integrators(const std::string& query, int limit, int offset, uint64_t) {
+    std::string pattern = "%";
+    for (char ch : query) {
+        if (ch == '%' || ch == '_' || ch == '\\') pattern += '\\';
+        pattern += ch;
+    }
+    pattern += '%';
+
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, SEARCH_INTEGRATORS);
+    StmtReset reset{st};
+    bind_text(st, 1, pattern);
+    sqlite3_bind_int(st, 2, limit + 1);
+    sqlite3_bind_int(st, 3, offset);
+
+    auto store = std::make_shared<IntegratorStore>();
+    std::vector<float> ranks;
+    int rc;
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        store->add(sqlite3_column_int(st, 0), column_text(st, 1), column_text(st, 2), column_text(st, 3));
+        ranks.push_back(float(sqlite3_column_double(st, 4)));
+    }
+    if (rc != SQLITE_DONE) {
+        std::cerr << "SQLite search error: " << sqlite3_errmsg((*r).db) << std::endl;
+        return {IntegratorRows(), {}, -1, false};
+    }
+
+    // Порядок по релевантности: хранилище не сортируется (finish не вызывается)
+    SearchPage page{IntegratorRows(std::move(store)), std::move(ranks), -1};
+    if (int(page.items.size()) > limit) {
+        page.items.truncate(limit);
+        page.ranks.resize(limit);
+        page.next_offset = offset + limit;
+    }
+    return page;
+}
+
+std::vector<BatchRowResult> SqliteStorage::add_integrators_batch(const std::vector<NewIntegrator>& rows,
+                                                                 uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    std::string error;
+    auto res = insert_rows(rows, error);
+    if (!error.empty()) std::cerr << "Batch insert error: " << error << std::endl;
+    return res;
+}
+
+ImportStats SqliteStorage::import_integrators_csv(const CsvSource& source, bool header, uint64_t* commit_token) {
+    if (commit_token) *commit_token = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    ImportStats st{false, "", 0, 0};
+    std::vector<NewIntegrator> rows;
+    if (parse_integrators_csv(source, header, rows, st.error)) {
+        insert_rows(rows, st.error);
+        st.ok = st.error.empty();
+        if (st.ok) st.rows = (long long)rows.size();
+    }
+    if (!st.ok) std::cerr << "Import error: " << st.error << std::endl;
+    st.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return st;
+}
+
+bool SqliteStorage::export_integrators_csv(const CsvSink& sink) {
+    return write_integrators_csv(*this, sink);
+}
+
+bool SqliteStorage::for_each_integrator(const std::function<bool(const IntegratorRef&)>& fn, uint64_t) {
+    Reader r(*this);
+    sqlite3_stmt* st = stmt(*r, SELECT_INTEGRATORS);
+    StmtReset reset{st};
+    int rc;
+    while ((rc = sqlite3_step(st)) == SQLITE_ROW) {
+        if (!fn({sqlite3_column_int(st, 0), column_text(st, 1), column_text(st, 2), column_text(st, 3)}))
+            return true;
+    }
+    if (rc != SQLITE_DONE) {
+        std::cerr << "SQLite select error: " << sqlite3_errmsg((*r).db) << std::endl;
+        return false;
+    }
+    return true;
+}
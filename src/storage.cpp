@@ -0,0 +1,210 @@
+#include "storage.h"
+#include <algorithm>
+#include <sstream>
+
+long long store_count(const IntegratorStore& store, const IntegratorFilter& filter) {
+    std::optional<IntegratorStore::Code> city, activity;
+    if (!filter.city.empty() && !(city = store.city_code(filter.city))) return 0;
+    if (!filter.activity.empty() && !(activity = store.activity_code(filter.activity))) return 0;
+    return (long long)store.count(city, activity);
+}
+
+IntegratorSet::IntegratorSet(std::vector<Part> parts) : list(std::move(parts)) {
+    for (auto& p : list) {
+        offsets.push_back(total);
+        total += p->size();
+    }
+}
+
+size_t IntegratorSet::memory_bytes() const {
+    size_t n = 0;
+    for (auto& p : list) n += p->memory_bytes();
+    return n;
+}
+
+IntegratorRef IntegratorSet::row(size_t i) const {
+    size_t k = size_t(std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin()) - 1;
+    const IntegratorStore& s = *list[k];
+    size_t r = i - offsets[k];
+    return {s.id(r), s.name(r), s.city(r), s.activity(r)};
+}
+
+void IntegratorSet::visit(const std::function<bool(uint32_t)>& fn) const {
+    // Слияние по id: частей единицы, поэтому минимум ищется перебором
+    std::vector<size_t> pos(list.size(), 0);
+    while (true) {
+        size_t best = list.size();
+        for (size_t k = 0; k < list.size(); k++) {
+            if (pos[k] == list[k]->size()) continue;
+            if (best == list.size() || list[k]->id(pos[k]) < list[best]->id(pos[best])) best = k;
+        }
+        if (best == list.size()) return;
+        if (!fn(uint32_t(offsets[best] + pos[best]++))) return;
+    }
+}
+
+void IntegratorSet::scan(int after_id, const IntegratorFilter& filter, size_t limit,
+                         std::vector<uint32_t>& out) const {
+    // Из каждой части — до limit подходящих строк, затем первые limit по id
+    std::vector<std::pair<int, uint32_t>> hits;
+    std::vector<uint32_t> rows;
+    for (size_t k = 0; k < list.size(); k++) {
+        const IntegratorStore& s = *list[k];
+        std::optional<IntegratorStore::Code> city, activity;
+        if (!filter.city.empty() && !(city = s.city_code(filter.city))) continue;
+        if (!filter.activity.empty() && !(activity = s.activity_code(filter.activity))) continue;
+        rows.clear();
+        s.scan(s.upper_bound(after_id), city, activity, limit, rows);
+        for (uint32_t r : rows) hits.push_back({s.id(r), uint32_t(offsets[k] + r)});
+    }
+    size_t n = std::min(limit, hits.size());
+    std::partial_sort(hits.begin(), hits.begin() + n, hits.end());
+    for (size_t i = 0; i < n; i++) out.push_back(hits[i].second);
+}
+
+long long IntegratorSet::count(const IntegratorFilter& filter) const {
+    long long n = 0;
+    for (auto& p : list) n += store_count(*p, filter);
+    return n;
+}
+
+static IntegratorRef set_row(const void* owner, size_t i) {
+    return static_cast<const IntegratorSet*>(owner)->row(i);
+}
+
+IntegratorPage set_page(std::shared_ptr<const IntegratorSet> set, int after_id, int limit,
+                        const IntegratorFilter& filter) {
+    std::vector<uint32_t> rows;
+    rows.reserve(limit + 1);
+    set->scan(after_id, filter, size_t(limit) + 1, rows);
+    int next_after = -1;
+    if (int(rows.size()) > limit) {
+        rows.pop_back();
+        next_after = set->row(rows.back()).id;
+    }
+    return {IntegratorRows(std::move(set), set_row, std::move(rows)), next_after};
+}
+
+IntegratorRows set_rows(std::shared_ptr<const IntegratorSet> set) {
+    if (set->parts().size() == 1) return IntegratorRows(set->parts()[0]);
+    std::vector<uint32_t> order;
+    order.reserve(set->size());
+    set->visit([&](uint32_t i) { order.push_back(i); return true; });
+    return IntegratorRows(std::move(set), set_row, std::move(order));
+}
+
+IntegratorRows set_rows(std::shared_ptr<const IntegratorSet> set, std::vector<uint32_t> rows) {
+    return IntegratorRows(std::move(set), set_row, std::move(rows));
+}
+
+std::vector<NewIntegrator> parse_integrators_tsv(std::istream& in) {
+    std::vector<NewIntegrator> rows;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        NewIntegrator n;
+        std::istringstream fields(line);
+        std::getline(fields, n.name, '\t');
+        std::getline(fields, n.city, '\t');
+        std::getline(fields, n.activity);
+        rows.push_back(std::move(n));
+    }
+    return rows;
+}
+
+bool parse_integrators_csv(const CsvSource& source, bool header,
+                           std::vector<NewIntegrator>& rows, std::string& error) {
+    // Конечный автомат по байтам: куски источника режут строки и поля где угодно
+    std::vector<std::string> fields(1);
+    bool quoted = false;        // внутри кавычек
+    bool quote_seen = false;    // предыдущий символ в кавычках — '"' (конец или экранирование)
+    bool skip = header;
+    long long line = 1;
+    bool bad = false;
+
+    auto end_row = [&]() {
+        if (fields.size() == 1 && fields[0].empty()) return;   // пустая строка
+        if (skip) {
+            skip = false;
+        } else if (fields.size() != 3) {
+            error = "line " + std::to_string(line) + ": expected 3 fields, got " + std::to_string(fields.size());
+            bad = true;
+        } else {
+            rows.push_back({std::move(fields[0]), std::move(fields[1]), std::move(fields[2])});
+        }
+        fields.assign(1, std::string());
+    };
+
+    bool ok = source([&](const char* data, size_t len) {
+        for (size_t i = 0; i < len && !bad; i++) {
+            char ch = data[i];
+            if (quoted) {
+                if (quote_seen) {
+                    quote_seen = false;
+                    if (ch == '"') { fields.back() += '"'; continue; }
+                    quoted = false;     // закрывающая кавычка, символ разбирается ниже
+                } else if (ch == '"') {
+                    quote_seen = true;
+                    continue;
+                } else {
+                    if (ch == '\n') line++;
+                    fields.back() += ch;
+                    continue;
+                }
+            }
+            if (ch == '"' && fields.back().empty()) quoted = true;
+            else if (ch == ',') fields.emplace_back();
+            else if (ch == '\n') { end_row(); line++; }
+            else if (ch != '\r') fields.back() += ch;
+        }
+        return !bad;
+    });
+    if (bad) return false;
+    if (!ok) {
+        error = "read error";
+        return false;
+    }
+    if (quoted && !quote_seen) {
+        error = "line " + std::to_string(line) + ": unterminated quote";
+        return false;
+    }
+    end_row();
+    return !bad;
+}
+
+void append_csv_field(std::string& out, std::string_view field) {
+    if (field.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out += field;
+        return;
+    }
+    out += '"';
+    for (char ch : field) {
+        if (ch == '"') out += '"';
+        out += ch;
+    }
+    out += '"';
+}
+
+bool write_integrators_csv(Storage& storage, const CsvSink& sink) {
+    const size_t flush_size = 64 * 1024;
+    std::string buf;
+    bool sent = true;
+    bool ok = storage.for_each_integrator([&](const IntegratorRef& it) {
+        buf += std::to_string(it.id);
+        buf += ',';
+        append_csv_field(buf, it.name);
+        buf += ',';
+        append_csv_field(buf, it.city);
+        buf += ',';
+        append_csv_field(buf, it.activity);
+        buf += '\n';
+        if (buf.size() >= flush_size) {
+            sent = sink(buf.data(), buf.size());
+            buf.clear();
+        }
+        return sent;
+    });
+    if (ok && sent && !buf.empty()) sent = sink(buf.data(), buf.size());
+    return ok && sent;
+}
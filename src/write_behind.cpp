@@ -0,0 +1,97 @@
+#include "write_behind.h"
+#include <algorithm>
+#include <iostream>
+
+WriteBehind::WriteBehind(Storage& storage, const WriteBehindConfig& cfg)
+    : storage(storage), cfg(cfg) {
+    if (this->cfg.max_batch == 0) this->cfg.max_batch = 1;
+    writer = std::thread([this]() { run(); });
+}
+
+WriteBehind::~WriteBehind() {
+    {
+        std::lock_guard<std::mutex> lk(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    writer.join();
+}
+
+std::future<QueuedWrite> WriteBehind::submit(NewIntegrator row) {
+    std::future<QueuedWrite> f;
+    {
+        std::lock_guard<std::mutex> lk(m);
+        if (stopping || queue.size() >= cfg.queue_limit) throw WriteQueueFull();
+        queue.push_back(Pending{std::move(row), {}});
+        f = queue.back().done.get_future();
+    }
+    cv.notify_one();
+    return f;
+}
+
+QueuedWrite WriteBehind::add(NewIntegrator row) {
+    return submit(std::move(row)).get();
+}
+
+void WriteBehind::run() {
+    std::vector<Pending> batch;
+    batch.reserve(cfg.max_batch);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(m);
+            cv.wait(lk, [this]() { return stopping || !queue.empty(); });
+            // При остановке очередь дописывается до конца
+            if (queue.empty()) return;
+
+            // Всё накопленное, пока шёл прошлый коммит, — без ожидания добора
+            size_t n = std::min(queue.size(), cfg.max_batch);
+            for (size_t i = 0; i < n; i++) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        commit(batch);
+        batch.clear();
+    }
+}
+
+void WriteBehind::commit(std::vector<Pending>& batch) {
+    std::vector<NewIntegrator> rows;
+    rows.reserve(batch.size());
+    for (auto& p : batch) rows.push_back(p.row);
+
+    // Метка коммита пачки; у повторов по одной — наибольшая
+    uint64_t lsn = 0, row_lsn = 0;
+    auto insert = [&](const std::vector<NewIntegrator>& v) {
+        auto r = storage.add_integrators_batch(v, &row_lsn);
+        lsn = std::max(lsn, row_lsn);
+        return r;
+    };
+
+    std::vector<BatchRowResult> res;
+    try {
+        res = insert(rows);
+    } catch (const std::exception& e) {
+        res.assign(rows.size(), BatchRowResult{-1, e.what()});
+    }
+    batch_count++;
+
+    bool failed = false;
+    for (auto& r : res) failed = failed || r.id < 0;
+    // Откат пачки из-за одной строки: остальные вставляются отдельно
+    if (failed && batch.size() > 1) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            try {
+                res[i] = insert({rows[i]})[0];
+            } catch (const std::exception& e) {
+                res[i] = {-1, e.what()};
+            }
+            if (res[i].id < 0) std::cerr << "Write-behind insert error: " << res[i].error << std::endl;
+        }
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (res[i].id >= 0) row_count++;
+        batch[i].done.set_value({res[i].id, res[i].error, lsn});
+    }
+}
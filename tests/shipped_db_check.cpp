@@ -0,0 +1,53 @@
+// Вход администратора на поставляемом integrators.db (пароль "1234", формат simple_hash).
+// Работает на копии файла: успешный вход перезаписывает хеш в PBKDF2.
+#include "sqlite_storage.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+static int failures = 0;
+
+static void expect(bool cond, const char* what) {
+    if (!cond) {
+        std::cerr << "FAIL: " << what << std::endl;
+        failures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: shipped_db_check <integrators.db> <копия>" << std::endl;
+        return 2;
+    }
+    {
+        std::ifstream src(argv[1], std::ios::binary);
+        std::ofstream dst(argv[2], std::ios::binary | std::ios::trunc);
+        if (!src || !dst) {
+            std::cerr << "cannot copy " << argv[1] << std::endl;
+            return 2;
+        }
+        dst << src.rdbuf();
+    }
+
+    KdfConfig kdf;
+    kdf.iterations = 1000;
+    SqliteConfig cfg;
+    cfg.path = argv[2];
+    {
+        SqliteStorage db(cfg, kdf);
+        db.init();
+        expect(db.has_admin(), "has_admin on the shipped db");
+        expect(!db.check_admin_password("wrong"), "wrong password rejected");
+        expect(db.check_admin_password("1234"), "legacy simple_hash password accepted");
+        // Второй вход — уже по перезаписанному PBKDF2-хешу
+        expect(db.check_admin_password("1234"), "password accepted after rehash");
+        expect(!db.check_admin_password("wrong"), "wrong password rejected after rehash");
+    }
+    std::remove(argv[2]);
+    std::remove((std::string(argv[2]) + "-wal").c_str());
+    std::remove((std::string(argv[2]) + "-shm").c_str());
+
+    if (failures) return 1;
+    std::cout << "shipped db admin login: ok" << std::endl;
+    return 0;
+}